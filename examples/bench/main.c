@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nui.h"
+
+#define ROWS (24)
+#define COLUMNS (3)
+// Operations past each limit in the limit cases
+#define EXTRA (64)
+
+static const NUI_AABB window_area = {10, 10, 480, 1200};
+
+static char labels[ROWS][COLUMNS][16];
+static char titles[NUI_CONTAINER_LIST_SIZE + EXTRA][16];
+
+static double now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Fixed-width font, so that the measurements cost the same in every case
+static void measure_text(NUI_UserFont font, const char *text, int *out_width,
+                         int *out_height) {
+    (void)font;
+    *out_width = 8 * (int)strlen(text);
+    *out_height = 16;
+}
+
+// A grid of buttons in columns of 80 pixels, 30% and the rest, laid out by a
+// single row spec
+static void row_frame(NUI_Context *ctx, int extra) {
+    static const NUI_Size columns[COLUMNS] = {NUI_PX(80), NUI_PERCENT(30),
+                                              NUI_FILL(1)};
+    (void)extra;
+
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Grid", window_area, NUI_WINDOW_NONE)) {
+        nui_layout_row(ctx, COLUMNS, columns, 0);
+        for (int row = 0; row < ROWS; row++) {
+            for (int column = 0; column < COLUMNS; column++) {
+                nui_button(ctx, labels[row][column]);
+            }
+        }
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+// The same grid emulated with nested pushes: the columns are resolved and
+// the rows measured by hand, then each cell gets its own layout
+static void nested_frame(NUI_Context *ctx, int extra) {
+    (void)extra;
+    const NUI_Style *style = &ctx->style;
+    int title_h = style->padding_y * 2 + style->title_text_height;
+    int content_x = window_area.x + style->margin;
+    int content_y = window_area.y + title_h + style->margin;
+    int content_w = window_area.w - style->margin * 2;
+
+    int available = content_w - style->margin * (COLUMNS - 1);
+    int widths[COLUMNS] = {80, available * 30 / 100, 0};
+    widths[2] = available - widths[0] - widths[1];
+
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Grid", window_area, NUI_WINDOW_NONE)) {
+        int y = content_y;
+        for (int row = 0; row < ROWS; row++) {
+            // Measure the row to find its height before laying it out
+            int row_h = 0;
+            for (int column = 0; column < COLUMNS; column++) {
+                int w, h;
+                nui_resources_measure_text(ctx->resources, labels[row][column],
+                                           &w, &h);
+                if (h + style->padding_y * 2 > row_h)
+                    row_h = h + style->padding_y * 2;
+            }
+
+            int x = content_x;
+            for (int column = 0; column < COLUMNS; column++) {
+                nui_layout_push(ctx, (NUI_AABB){x, y, widths[column], row_h},
+                                NUI_LAYOUT_VERTICAL);
+                nui_button(ctx, labels[row][column]);
+                nui_layout_pop(ctx);
+                x += widths[column] + style->margin;
+            }
+            y += row_h + style->margin;
+        }
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+// Each limit case does the same work within the limit, then again with
+// `extra` operations past it, so that the difference is what degrading
+// gracefully costs
+
+// Buttons filling the command buffer, the extra ones have their commands
+// dropped
+static void commands_frame(NUI_Context *ctx, int extra) {
+    static const NUI_Size columns[] = {NUI_FILL(1), NUI_FILL(1), NUI_FILL(1),
+                                       NUI_FILL(1)};
+    // Five commands per button, with its label in scissors of its own,
+    // leaving room for the window's commands
+    int buttons = (NUI_MAX_COMMANDS - 16) / 5 + extra;
+
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Commands", (NUI_AABB){0, 0, 2000, 20000},
+                         NUI_WINDOW_NONE)) {
+        nui_layout_row(ctx, 4, columns, 0);
+        for (int i = 0; i < buttons; i++) {
+            nui_button(ctx, labels[i % ROWS][i % COLUMNS]);
+        }
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+// Nested layouts as deep as the stack allows, the extra pushes are ignored
+static void layout_overflow_frame(NUI_Context *ctx, int extra) {
+    // The window's own layout takes the first slot
+    int depth = NUI_LAYOUT_STACK_SIZE - 1 + extra;
+
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Layouts", (NUI_AABB){0, 0, 400, 400},
+                         NUI_WINDOW_NONE)) {
+        for (int i = 0; i < depth; i++) {
+            nui_layout_push(ctx, (NUI_AABB){i, 40 + i, 200, 200},
+                            NUI_LAYOUT_VERTICAL);
+        }
+        nui_button(ctx, "Deepest");
+        for (int i = 0; i < depth; i++) {
+            nui_layout_pop(ctx);
+        }
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+// Nested scissors as deep as the stack allows, the extra pushes are ignored
+static void scissors_overflow_frame(NUI_Context *ctx, int extra) {
+    // The window's content scissors take the first slot and the button's
+    // label the last
+    int depth = NUI_SCISSORS_STACK_SIZE - 2 + extra;
+
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Scissors", (NUI_AABB){0, 0, 400, 400},
+                         NUI_WINDOW_NONE)) {
+        for (int i = 0; i < depth; i++) {
+            nui_scissors_push(ctx, (NUI_AABB){i, i, 400 - i, 400 - i});
+        }
+        nui_button(ctx, "Deepest");
+        for (int i = 0; i < depth; i++) {
+            nui_scissors_pop(ctx);
+        }
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+// A window followed by pops of the empty stacks, which are ignored
+static void underflow_frame(NUI_Context *ctx, int extra) {
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Underflow", (NUI_AABB){0, 0, 400, 400},
+                         NUI_WINDOW_NONE)) {
+        nui_button(ctx, "OK");
+        nui_window_end(ctx);
+    }
+    for (int i = 0; i < extra; i++) {
+        nui_layout_pop(ctx);
+        nui_scissors_pop(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+// As many windows as the container list holds, the extra ones are not drawn
+static void containers_frame(NUI_Context *ctx, int extra) {
+    nui_frame_begin(ctx);
+    for (int i = 0; i < NUI_CONTAINER_LIST_SIZE + extra; i++) {
+        if (nui_window_begin(ctx, titles[i], (NUI_AABB){i * 4, i * 4, 200, 80},
+                             NUI_WINDOW_NONE)) {
+            nui_button(ctx, "OK");
+            nui_window_end(ctx);
+        }
+    }
+    nui_frame_end(ctx);
+}
+
+// Row specs of the most columns allowed, the extra columns are ignored
+static void columns_frame(NUI_Context *ctx, int extra) {
+    NUI_Size columns[NUI_LAYOUT_MAX_COLUMNS + EXTRA];
+    for (int i = 0; i < NUI_LAYOUT_MAX_COLUMNS + extra; i++) {
+        columns[i] = NUI_FILL(1);
+    }
+
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Columns", (NUI_AABB){0, 0, 2000, 2000},
+                         NUI_WINDOW_NONE)) {
+        for (int row = 0; row < ROWS; row++) {
+            nui_layout_row(ctx, NUI_LAYOUT_MAX_COLUMNS + extra, columns, 0);
+            nui_button(ctx, labels[row][0]);
+        }
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+// A window followed by buttons outside of it, which are not drawn
+static void orphans_frame(NUI_Context *ctx, int extra) {
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Orphans", (NUI_AABB){0, 0, 400, 400},
+                         NUI_WINDOW_NONE)) {
+        nui_button(ctx, "OK");
+        nui_window_end(ctx);
+    }
+    for (int i = 0; i < extra; i++) {
+        nui_button(ctx, "Orphan");
+    }
+    nui_frame_end(ctx);
+}
+
+typedef struct {
+    const char *name;
+    void (*frame)(NUI_Context *ctx, int extra);
+} BenchCase;
+
+static const BenchCase layout_cases[] = {
+    {"row spec", row_frame},
+    {"nested push", nested_frame},
+};
+
+static const BenchCase limit_cases[] = {
+    {"commands", commands_frame},
+    {"layout stack", layout_overflow_frame},
+    {"scissors stack", scissors_overflow_frame},
+    {"underflows", underflow_frame},
+    {"containers", containers_frame},
+    {"columns", columns_frame},
+    {"orphans", orphans_frame},
+};
+
+static int limit_hits(const NUI_LimitCounters *limits) {
+    return limits->dropped_commands + limits->layout_overflows +
+           limits->layout_underflows + limits->scissors_overflows +
+           limits->scissors_underflows + limits->container_overflows +
+           limits->column_overflows + limits->orphan_widgets +
+           limits->allocation_failures;
+}
+
+// Returns the mean time of a frame in nanoseconds, draining the commands as
+// a backend would outside of the timing. Reports the commands and limit hits
+// of the last frame.
+static double run(const BenchCase *bench, int extra, int frames,
+                  int *out_commands, int *out_hits) {
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+
+    double total = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        double start = now_ns();
+        bench->frame(&ctx, extra);
+        total += now_ns() - start;
+
+        nui_command_stream_hash(&ctx, out_commands);
+        NUI_Command cmd;
+        while (nui_next_command(&ctx, &cmd)) {
+        }
+    }
+    *out_hits = limit_hits(&ctx.limits);
+
+    nui_destroy(&ctx);
+    return total / frames;
+}
+
+// Compares the row layout against the nested pushes it replaces, then
+// measures what hitting each fixed limit costs
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 20000;
+    if (frames <= 0) {
+        fprintf(stderr, "Usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    for (int row = 0; row < ROWS; row++) {
+        for (int column = 0; column < COLUMNS; column++) {
+            snprintf(labels[row][column], sizeof(labels[row][column]),
+                     "Item %d.%d", row, column);
+        }
+    }
+    for (int i = 0; i < NUI_CONTAINER_LIST_SIZE + EXTRA; i++) {
+        snprintf(titles[i], sizeof(titles[i]), "Window %d", i);
+    }
+
+    double ns[2];
+    for (int i = 0; i < 2; i++) {
+        int commands, hits;
+        ns[i] = run(&layout_cases[i], 0, frames, &commands, &hits);
+        if (hits > 0)
+            fprintf(stderr, "%s: hit a limit, timings are not comparable\n",
+                    layout_cases[i].name);
+        printf("%-14s %9.0f ns/frame  %4d commands\n", layout_cases[i].name,
+               ns[i], commands);
+    }
+    printf("nested push / row spec: %.2fx\n\n", ns[1] / ns[0]);
+
+    // Times per frame within the limit and past it, with the limit's hits
+    // per frame
+    printf("%-14s %9s %9s %6s %8s\n", "limit", "within", "past", "hits",
+           "ns/hit");
+    int limit_count = sizeof(limit_cases) / sizeof(limit_cases[0]);
+    for (int i = 0; i < limit_count; i++) {
+        int commands, within_hits, past_hits;
+        double within =
+            run(&limit_cases[i], 0, frames, &commands, &within_hits);
+        double past =
+            run(&limit_cases[i], EXTRA, frames, &commands, &past_hits);
+        if (within_hits > 0 || past_hits == 0)
+            fprintf(stderr, "%s: the limit was not hit as expected\n",
+                    limit_cases[i].name);
+        double per_hit = (past - within) / (past_hits > 0 ? past_hits : 1);
+        printf("%-14s %9.0f %9.0f %6d %8.1f\n", limit_cases[i].name, within,
+               past, past_hits, per_hit);
+    }
+    return 0;
+}
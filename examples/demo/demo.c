@@ -0,0 +1,36 @@
+#include "demo.h"
+
+#include <stdio.h>
+
+void demo_frame(NUI_Context *ctx) {
+    nui_frame_begin(ctx);
+
+    if (nui_window_begin(ctx, "Test Window", (NUI_AABB){10, 20, 300, 130},
+                         NUI_WINDOW_NONE)) {
+
+        static char labels[3][32];
+        for (int i = 0; i < 3; i++) {
+            snprintf(labels[i], sizeof(labels[i]), "Click Me %d", i + 1);
+            if (nui_button(ctx, labels[i])) {
+                printf("Button %d Clicked in Window 1!\n", i + 1);
+            }
+        }
+
+        nui_window_end(ctx);
+    }
+
+    if (nui_window_begin(ctx, "Test Window2", (NUI_AABB){120, 80, 300, 130},
+                         NUI_WINDOW_CACHED)) {
+        static char labels[3][32];
+        for (int i = 0; i < 3; i++) {
+            snprintf(labels[i], sizeof(labels[i]), "Click Me %d", i + 1);
+            if (nui_button(ctx, labels[i])) {
+                printf("Button %d Clicked in Window 2!\n", i + 1);
+            }
+        }
+
+        nui_window_end(ctx);
+    }
+
+    nui_frame_end(ctx);
+}
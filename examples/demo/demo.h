@@ -0,0 +1,10 @@
+#ifndef DEMO_H
+#define DEMO_H
+
+#include "nui.h"
+
+// Builds one frame of the demo UI, shared by the SDL2 example and the
+// headless replay tool so that recorded traces replay against the same UI
+void demo_frame(NUI_Context *ctx);
+
+#endif // DEMO_H
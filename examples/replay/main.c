@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "demo.h"
+#include "nui.h"
+#include "nui_trace.h"
+
+static double now_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// Replays a trace recorded by the SDL2 example against the same demo UI,
+// failing if any frame's command stream differs from the recording
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace> [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 1;
+
+    int mismatches = 0;
+    int frame_count = 0;
+    int frame_capacity = 0;
+    double *frame_ms = NULL;
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        NUI_TracePlayer player;
+        if (!nui_trace_play_begin(&player, argv[1])) {
+            fprintf(stderr, "Failed to open trace file: %s\n", argv[1]);
+            return 1;
+        }
+
+        NUI_Context ctx;
+        nui_init(&ctx, nui_trace_play_measure_text, &player);
+
+        NUI_TraceFrame expected;
+        NUI_TraceStatus status;
+        int frame = 0;
+        while ((status = nui_trace_play_frame(&player, &ctx, &expected)) ==
+               NUI_TRACE_FRAME) {
+            double start = now_ms();
+            demo_frame(&ctx);
+            double elapsed = now_ms() - start;
+
+            // Hashing is only for checking the output, outside of the timing
+            int count;
+            NUI_Id hash = nui_command_stream_hash(&ctx, &count);
+
+            if (count != expected.command_count ||
+                hash != expected.command_hash) {
+                fprintf(stderr,
+                        "Frame %d: expected %d commands (hash %u), got %d "
+                        "(hash %u)\n",
+                        frame, expected.command_count,
+                        (unsigned int)expected.command_hash, count,
+                        (unsigned int)hash);
+                mismatches++;
+            }
+
+            if (frame_count == frame_capacity) {
+                frame_capacity = frame_capacity ? frame_capacity * 2 : 1024;
+                frame_ms = realloc(frame_ms, frame_capacity * sizeof(double));
+                if (!frame_ms) {
+                    fprintf(stderr, "Out of memory\n");
+                    return 1;
+                }
+            }
+            frame_ms[frame_count++] = elapsed;
+            frame++;
+        }
+
+        nui_destroy(&ctx);
+        nui_trace_play_end(&player);
+
+        if (status == NUI_TRACE_ERROR) {
+            fprintf(stderr, "Malformed or truncated trace after frame %d: %s\n",
+                    frame, argv[1]);
+            free(frame_ms);
+            return 1;
+        }
+    }
+
+    if (frame_count > 0) {
+        double total = 0;
+        for (int i = 0; i < frame_count; i++) {
+            total += frame_ms[i];
+        }
+        qsort(frame_ms, frame_count, sizeof(double), compare_doubles);
+
+        printf("frames: %d\n", frame_count);
+        printf("mean:   %.4f ms\n", total / frame_count);
+        printf("p50:    %.4f ms\n", frame_ms[frame_count / 2]);
+        printf("p99:    %.4f ms\n", frame_ms[frame_count * 99 / 100]);
+        printf("max:    %.4f ms\n", frame_ms[frame_count - 1]);
+    }
+    free(frame_ms);
+
+    if (mismatches > 0) {
+        fprintf(stderr, "%d mismatched frames\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -1,13 +1,20 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "demo.h"
 #include "nui.h"
+#include "nui_trace.h"
 
 #define WINDOW_WIDTH (800)
 #define WINDOW_HEIGHT (600)
+#define IMAGE_BATCH_SIZE (64)
+#define CONTAINER_CACHE_SIZE (8)
+#define TEXT_BUFFER_SIZE (1024)
 
 #define TODO(x)                                                                \
     do {                                                                       \
@@ -38,8 +45,15 @@ void sdl_measure_text(NUI_UserFont font, const char *text, int *out_width,
 
 void sdl_render_text(SDL_Renderer *renderer, TTF_Font *font,
                      const NUI_CommandText *text_cmd) {
+    // SDL_ttf needs a NUL-terminated string, text commands are slices
+    static char text[TEXT_BUFFER_SIZE];
+    int length = text_cmd->length < TEXT_BUFFER_SIZE ? text_cmd->length
+                                                     : TEXT_BUFFER_SIZE - 1;
+    memcpy(text, text_cmd->text, length);
+    text[length] = '\0';
+
     SDL_Color color = *(SDL_Color *)(&text_cmd->color);
-    SDL_Surface *surf = TTF_RenderText_Blended(font, text_cmd->text, color);
+    SDL_Surface *surf = TTF_RenderText_Blended(font, text, color);
     if (surf) {
         SDL_Texture *tex = SDL_CreateTextureFromSurface(renderer, surf);
         SDL_Rect dst = {text_cmd->x, text_cmd->y, surf->w, surf->h};
@@ -58,6 +72,252 @@ void sdl_set_scissors(SDL_Renderer *renderer,
     SDL_RenderSetClipRect(renderer, &rect);
 }
 
+static void sdl_push_image_quad(SDL_Vertex *vertices, int *indices,
+                                int quad_index,
+                                const NUI_CommandImage *image_cmd) {
+    const NUI_AABB *r = &image_cmd->rect;
+    const NUI_UVRect *uv = &image_cmd->uv;
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+
+    SDL_Vertex *v = &vertices[quad_index * 4];
+    v[0] = (SDL_Vertex){{r->x, r->y}, white, {uv->u0, uv->v0}};
+    v[1] = (SDL_Vertex){{r->x + r->w, r->y}, white, {uv->u1, uv->v0}};
+    v[2] = (SDL_Vertex){{r->x + r->w, r->y + r->h}, white, {uv->u1, uv->v1}};
+    v[3] = (SDL_Vertex){{r->x, r->y + r->h}, white, {uv->u0, uv->v1}};
+
+    int base = quad_index * 4;
+    int *i = &indices[quad_index * 6];
+    i[0] = base + 0;
+    i[1] = base + 1;
+    i[2] = base + 2;
+    i[3] = base + 0;
+    i[4] = base + 2;
+    i[5] = base + 3;
+}
+
+// Draws the given image and the images following it that share its texture,
+// up to max_count in total, batching them into single geometry calls.
+// Returns the number of images drawn.
+int sdl_render_images(SDL_Renderer *renderer, NUI_Context *ctx,
+                      const NUI_CommandImage *image_cmd, int max_count) {
+    static NUI_CommandImage batch[IMAGE_BATCH_SIZE];
+    static SDL_Vertex vertices[IMAGE_BATCH_SIZE * 4];
+    static int indices[IMAGE_BATCH_SIZE * 6];
+
+    int limit = SDL_min(IMAGE_BATCH_SIZE, max_count);
+    batch[0] = *image_cmd;
+    int count = 1 + nui_next_image_batch(ctx, image_cmd->texture, &batch[1],
+                                         limit - 1);
+    int drawn = 0;
+    while (count > 0) {
+        for (int i = 0; i < count; i++) {
+            sdl_push_image_quad(vertices, indices, i, &batch[i]);
+        }
+        SDL_RenderGeometry(renderer, (SDL_Texture *)image_cmd->texture,
+                           vertices, count * 4, indices, count * 6);
+        drawn += count;
+
+        count = nui_next_image_batch(ctx, image_cmd->texture, batch,
+                                     SDL_min(IMAGE_BATCH_SIZE,
+                                             max_count - drawn));
+    }
+
+    return drawn;
+}
+
+static int sdl_render_command(SDL_Renderer *renderer, TTF_Font *font,
+                              NUI_Context *ctx, const NUI_Command *cmd,
+                              int max_count);
+
+// Offscreen targets of cached windows, evicting the least recently drawn
+// window when full
+static struct {
+    NUI_Id id;
+    SDL_Texture *texture;
+    int w, h;
+    unsigned int last_used;
+} container_caches[CONTAINER_CACHE_SIZE];
+static unsigned int container_cache_frame;
+
+// Returns the cached target for `id`, if it has one
+static SDL_Texture *sdl_find_container_cache(NUI_Id id) {
+    for (int i = 0; i < CONTAINER_CACHE_SIZE; i++) {
+        if (container_caches[i].texture && container_caches[i].id == id) {
+            container_caches[i].last_used = container_cache_frame;
+            return container_caches[i].texture;
+        }
+    }
+    return NULL;
+}
+
+// Returns a target of the given size for `id`, taking it from the least
+// recently drawn window when the cache is full. The window losing its target
+// is invalidated, so that it redraws once it gets one again. Returns NULL
+// when every target is in use this frame or cannot be created.
+static SDL_Texture *sdl_get_container_cache(SDL_Renderer *renderer,
+                                            NUI_Context *ctx, NUI_Id id,
+                                            int w, int h) {
+    int slot = -1;
+    for (int i = 0; i < CONTAINER_CACHE_SIZE; i++) {
+        if (container_caches[i].texture && container_caches[i].id == id) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 || !container_caches[i].texture ||
+            (container_caches[slot].texture &&
+             container_caches[i].last_used < container_caches[slot].last_used))
+            slot = i;
+    }
+    if (container_caches[slot].texture && container_caches[slot].id != id) {
+        if (container_caches[slot].last_used == container_cache_frame)
+            return NULL;
+        nui_container_invalidate_id(ctx, container_caches[slot].id);
+        SDL_DestroyTexture(container_caches[slot].texture);
+        container_caches[slot].texture = NULL;
+    }
+
+    // (Re)create the target on first use or when the container resized
+    if (!container_caches[slot].texture || container_caches[slot].w != w ||
+        container_caches[slot].h != h) {
+        if (container_caches[slot].texture)
+            SDL_DestroyTexture(container_caches[slot].texture);
+        container_caches[slot].id = id;
+        container_caches[slot].w = w;
+        container_caches[slot].h = h;
+        container_caches[slot].texture =
+            SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                              SDL_TEXTUREACCESS_TARGET, w, h);
+        if (!container_caches[slot].texture)
+            return NULL;
+        SDL_SetTextureBlendMode(container_caches[slot].texture,
+                                SDL_BLENDMODE_BLEND);
+    }
+    container_caches[slot].last_used = container_cache_frame;
+    return container_caches[slot].texture;
+}
+
+// Drops every cached target after the renderer lost their contents, and
+// redraws the windows on the next frame
+static void sdl_reset_container_caches(NUI_Context *ctx) {
+    for (int i = 0; i < CONTAINER_CACHE_SIZE; i++) {
+        if (!container_caches[i].texture)
+            continue;
+        nui_container_invalidate_id(ctx, container_caches[i].id);
+        SDL_DestroyTexture(container_caches[i].texture);
+        container_caches[i].texture = NULL;
+    }
+}
+
+void sdl_render_cached_container(SDL_Renderer *renderer, TTF_Font *font,
+                                 NUI_Context *ctx,
+                                 const NUI_CommandCachedContainer *cached_cmd) {
+    SDL_Rect dst = {cached_cmd->area.x, cached_cmd->area.y, cached_cmd->area.w,
+                    cached_cmd->area.h};
+
+    if (!cached_cmd->dirty) {
+        SDL_Texture *target = sdl_find_container_cache(cached_cmd->id);
+        if (target) {
+            SDL_RenderCopy(renderer, target, NULL, &dst);
+        } else {
+            // The target was evicted after this frame was built, so there is
+            // nothing to draw until the window redraws next frame
+            nui_container_invalidate_id(ctx, cached_cmd->id);
+        }
+        return;
+    }
+
+    // Redraw the cached target from the container-local commands that
+    // follow. Without a target, draw them straight to the screen through a
+    // viewport at the window's area, and redraw again next frame.
+    SDL_Texture *target = sdl_get_container_cache(
+        renderer, ctx, cached_cmd->id, cached_cmd->area.w, cached_cmd->area.h);
+    if (target) {
+        SDL_SetRenderTarget(renderer, target);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+    } else {
+        SDL_RenderSetViewport(renderer, &dst);
+        nui_container_invalidate_id(ctx, cached_cmd->id);
+    }
+
+    // Image batches drain several commands at once, count all of them so
+    // that drawing stops at the end of the container's slice
+    NUI_Command cmd;
+    int drawn = 0;
+    while (drawn < cached_cmd->command_count && nui_next_command(ctx, &cmd)) {
+        drawn += sdl_render_command(renderer, font, ctx, &cmd,
+                                    cached_cmd->command_count - drawn);
+    }
+
+    if (target) {
+        SDL_SetRenderTarget(renderer, NULL);
+        SDL_RenderSetClipRect(renderer, NULL);
+        SDL_RenderCopy(renderer, target, NULL, &dst);
+    } else {
+        SDL_RenderSetClipRect(renderer, NULL);
+        SDL_RenderSetViewport(renderer, NULL);
+    }
+}
+
+// Renders the command along with the commands it drains, up to max_count in
+// total. Returns the number of commands rendered.
+static int sdl_render_command(SDL_Renderer *renderer, TTF_Font *font,
+                              NUI_Context *ctx, const NUI_Command *cmd,
+                              int max_count) {
+    switch (cmd->type) {
+    case NUI_CMD_RECT:
+        sdl_render_rect(renderer, &cmd->rect);
+#ifdef PRINT_CMDS_ONCE
+        printf("  NUI_CMD_RECT: x=%d y=%d w=%d h=%d color=(%d,%d,%d,%d)\n",
+               cmd->rect.rect.x, cmd->rect.rect.y, cmd->rect.rect.w,
+               cmd->rect.rect.h, cmd->rect.color.r, cmd->rect.color.g,
+               cmd->rect.color.b, cmd->rect.color.a);
+#endif
+        break;
+    case NUI_CMD_TEXT:
+        sdl_render_text(renderer, font, &cmd->text);
+#ifdef PRINT_CMDS_ONCE
+        printf("  NUI_CMD_TEXT: x=%d y=%d text=\"%.*s\" "
+               "color=(%d,%d,%d,%d)\n",
+               cmd->text.x, cmd->text.y, cmd->text.length, cmd->text.text,
+               cmd->text.color.r, cmd->text.color.g, cmd->text.color.b,
+               cmd->text.color.a);
+#endif
+        break;
+    case NUI_CMD_SCISSORS:
+        sdl_set_scissors(renderer, &cmd->scissors);
+#ifdef PRINT_CMDS_ONCE
+        printf("  NUI_CMD_SCISSORS: area=(x=%d y=%d w=%d h=%d)\n",
+               cmd->scissors.area.x, cmd->scissors.area.y,
+               cmd->scissors.area.w, cmd->scissors.area.h);
+#endif
+        break;
+    case NUI_CMD_CACHED_CONTAINER:
+#ifdef PRINT_CMDS_ONCE
+        printf("  NUI_CMD_CACHED_CONTAINER: id=%u area=(x=%d y=%d w=%d h=%d) "
+               "dirty=%d command_count=%d\n",
+               cmd->cached.id, cmd->cached.area.x, cmd->cached.area.y,
+               cmd->cached.area.w, cmd->cached.area.h, cmd->cached.dirty,
+               cmd->cached.command_count);
+#endif
+        sdl_render_cached_container(renderer, font, ctx, &cmd->cached);
+        break;
+    case NUI_CMD_IMAGE:
+#ifdef PRINT_CMDS_ONCE
+        printf("  NUI_CMD_IMAGE: x=%d y=%d w=%d h=%d texture=%p "
+               "uv=(%f,%f,%f,%f)\n",
+               cmd->image.rect.x, cmd->image.rect.y, cmd->image.rect.w,
+               cmd->image.rect.h, cmd->image.texture, cmd->image.uv.u0,
+               cmd->image.uv.v0, cmd->image.uv.u1, cmd->image.uv.v1);
+#endif
+        return sdl_render_images(renderer, ctx, &cmd->image, max_count);
+    default:
+        UNREACHABLE("NUI_CommandType");
+    }
+
+    return 1;
+}
+
 int main(int argc, char *argv[]) {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "SDL could not initialize! SDL_Error: %s\n",
@@ -94,9 +354,23 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Initialize context
+    // Optionally record the session for headless replay
+    NUI_TraceRecorder recorder = {0};
+    if (argc == 3 && strcmp(argv[1], "--record") == 0) {
+        if (!nui_trace_record_begin(&recorder, argv[2], sdl_measure_text,
+                                    default_font)) {
+            fprintf(stderr, "Failed to open trace file: %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    // Initialize context, measuring text through the recorder if recording
     NUI_Context ctx = {0};
-    nui_init(&ctx, sdl_measure_text, default_font);
+    if (recorder.file) {
+        nui_init(&ctx, nui_trace_record_measure_text, &recorder);
+    } else {
+        nui_init(&ctx, sdl_measure_text, default_font);
+    }
 
     bool quit = false;
     SDL_Event e;
@@ -108,12 +382,18 @@ int main(int argc, char *argv[]) {
                 quit = true;
                 break;
             case SDL_MOUSEMOTION:
-                nui_input_mouse_move(&ctx, e.motion.x, e.motion.y);
+                nui_trace_record_mouse_move(&recorder, &ctx, e.motion.x,
+                                            e.motion.y);
                 break;
 
             case SDL_MOUSEBUTTONDOWN:
             case SDL_MOUSEBUTTONUP:
-                nui_input_mouse_button(&ctx, e.type == SDL_MOUSEBUTTONDOWN);
+                nui_trace_record_mouse_button(&recorder, &ctx,
+                                              e.type == SDL_MOUSEBUTTONDOWN);
+                break;
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                sdl_reset_container_caches(&ctx);
                 break;
             default:
                 break;
@@ -121,36 +401,9 @@ int main(int argc, char *argv[]) {
         }
 
         // UI / Logic
-        nui_frame_begin(&ctx);
-
-        if (nui_window_begin(&ctx, "Test Window",
-                             (NUI_AABB){10, 20, 300, 130})) {
-
-            static char labels[3][32];
-            for (int i = 0; i < 3; i++) {
-                snprintf(labels[i], sizeof(labels[i]), "Click Me %d", i + 1);
-                if (nui_button(&ctx, labels[i])) {
-                    printf("Button %d Clicked in Window 1!\n", i + 1);
-                }
-            }
-
-            nui_window_end(&ctx);
-        }
-
-        if (nui_window_begin(&ctx, "Test Window2",
-                             (NUI_AABB){120, 80, 300, 130})) {
-            static char labels[3][32];
-            for (int i = 0; i < 3; i++) {
-                snprintf(labels[i], sizeof(labels[i]), "Click Me %d", i + 1);
-                if (nui_button(&ctx, labels[i])) {
-                    printf("Button %d Clicked in Window 2!\n", i + 1);
-                }
-            }
-
-            nui_window_end(&ctx);
-        }
-
-        nui_frame_end(&ctx);
+        container_cache_frame++;
+        demo_frame(&ctx);
+        nui_trace_record_frame(&recorder, &ctx);
 
         // Drain Command Buffer and render
         SDL_SetRenderDrawColor(renderer, 40, 40, 50, 255);
@@ -158,37 +411,7 @@ int main(int argc, char *argv[]) {
 
         NUI_Command cmd;
         while (nui_next_command(&ctx, &cmd)) {
-            switch (cmd.type) {
-            case NUI_CMD_RECT:
-                sdl_render_rect(renderer, &cmd.rect);
-#ifdef PRINT_CMDS_ONCE
-                printf(
-                    "  NUI_CMD_RECT: x=%d y=%d w=%d h=%d color=(%d,%d,%d,%d)\n",
-                    cmd.rect.rect.x, cmd.rect.rect.y, cmd.rect.rect.w,
-                    cmd.rect.rect.h, cmd.rect.color.r, cmd.rect.color.g,
-                    cmd.rect.color.b, cmd.rect.color.a);
-#endif
-                break;
-            case NUI_CMD_TEXT:
-                sdl_render_text(renderer, default_font, &cmd.text);
-#ifdef PRINT_CMDS_ONCE
-                printf("  NUI_CMD_TEXT: x=%d y=%d text=\"%s\" "
-                       "color=(%d,%d,%d,%d)\n",
-                       cmd.text.x, cmd.text.y, cmd.text.text, cmd.text.color.r,
-                       cmd.text.color.g, cmd.text.color.b, cmd.text.color.a);
-#endif
-                break;
-            case NUI_CMD_SCISSORS:
-                sdl_set_scissors(renderer, &cmd.scissors);
-#ifdef PRINT_CMDS_ONCE
-                printf("  NUI_CMD_SCISSORS: area=(x=%d y=%d w=%d h=%d)\n",
-                       cmd.scissors.area.x, cmd.scissors.area.y,
-                       cmd.scissors.area.w, cmd.scissors.area.h);
-#endif
-                break;
-            default:
-                UNREACHABLE("NUI_CommandType");
-            }
+            sdl_render_command(renderer, default_font, &ctx, &cmd, INT_MAX);
         }
 
 #ifdef PRINT_CMDS_ONCE
@@ -198,6 +421,9 @@ int main(int argc, char *argv[]) {
         SDL_RenderPresent(renderer);
     }
 
+    nui_destroy(&ctx);
+    nui_trace_record_end(&recorder);
+
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -6,12 +6,14 @@ EMSCRIPTEN_KEEPALIVE
 void run_ui_frame(NUI_Context *ctx) {
     nui_frame_begin(ctx);
 
-    if (nui_window_begin(ctx, "WASM Window", (NUI_AABB){50, 50, 300, 200})) {
+    if (nui_window_begin(ctx, "WASM Window", (NUI_AABB){50, 50, 300, 200},
+                         NUI_WINDOW_NONE)) {
         nui_button(ctx, "Hello from WASM");
         nui_window_end(ctx);
     }
 
-    if (nui_window_begin(ctx, "WASM Window 2", (NUI_AABB){80, 80, 300, 200})) {
+    if (nui_window_begin(ctx, "WASM Window 2", (NUI_AABB){80, 80, 300, 200},
+                         NUI_WINDOW_NONE)) {
         nui_button(ctx, "Hello from WASM Again");
         nui_window_end(ctx);
     }
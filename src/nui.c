@@ -1,20 +1,55 @@
 #include "nui.h"
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(NUI_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NUI_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define NUI_SIMD_NEON
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#define NUI_SIMD_WASM
+#include <wasm_simd128.h>
+#endif
+#endif
+
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
+#define NUI_FIXED_SHIFT (8)
+#define NUI_FIXED_ONE (1 << NUI_FIXED_SHIFT)
+#define NUI_FIXED_FROM_INT(v) ((NUI_Fixed)(v) * NUI_FIXED_ONE)
+#define NUI_FIXED_MAX NUI_FIXED_FROM_INT(NUI_COORD_MAX)
+
+#define NUI_MIN_SCALE (1.0f / NUI_FIXED_ONE)
+#define NUI_MAX_SCALE (64.0f)
+
+// Runs the pending clipping pass to reclaim the commands of fully clipped
+// primitives before giving up on a full command buffer
 #define NUI_NEXT_COMMAND_SAFE(ctx)                                             \
-    ((ctx->command_count < NUI_MAX_COMMANDS)                                   \
+    ((ctx->command_count < ctx->command_capacity ||                            \
+      nui_reclaim_commands(ctx))                                               \
          ? (&ctx->commands[ctx->command_count++])                              \
-         : (assert(0 && "NUI Command buffer overflow"), (NUI_Command *)0))
+         : (ctx->limits.dropped_commands++, (NUI_Command *)0))
+
+// Size of primitives whose extent is unknown, e.g. text growing right and
+// down from its origin
+#define NUI_UNBOUNDED (0x10000000)
+
+_Static_assert((NUI_TEXT_CACHE_SIZE & (NUI_TEXT_CACHE_SIZE - 1)) == 0,
+               "NUI_TEXT_CACHE_SIZE must be a power of two");
+_Static_assert((NUI_WORD_CACHE_SIZE & (NUI_WORD_CACHE_SIZE - 1)) == 0,
+               "NUI_WORD_CACHE_SIZE must be a power of two");
 
 // Scissors covering the entire possible area
 static const NUI_AABB NUI_ROOT_SCISSORS =
-    (NUI_AABB){0, 0, 0x10000000, 0x10000000};
+    (NUI_AABB){0, 0, NUI_UNBOUNDED, NUI_UNBOUNDED};
 
 const NUI_Style nui_default_style = {
     .text = {0xFF, 0xFF, 0xFF, 0xFF},
@@ -32,8 +67,86 @@ const NUI_Style nui_default_style = {
     .padding_x = 12,
     .padding_y = 8,
     .margin = 10,
+
+    .title_text_height = 16,
+
+    .text_area_bg = {0x22, 0x22, 0x22, 0xFF},
 };
 
+// Rect in device pixels as 24.8 fixed-point
+typedef struct {
+    NUI_Fixed x, y, w, h;
+} NUI_FixedAABB;
+
+static inline int nui_fixed_floor(NUI_Fixed v) {
+    return (v >= 0) ? v / NUI_FIXED_ONE
+                    : -((-v + NUI_FIXED_ONE - 1) / NUI_FIXED_ONE);
+}
+
+static inline int nui_fixed_round(NUI_Fixed v) {
+    return nui_fixed_floor(v + NUI_FIXED_ONE / 2);
+}
+
+static inline int nui_clamp_coord(int64_t v) {
+    return (int)MIN(MAX(v, -NUI_COORD_MAX), NUI_COORD_MAX);
+}
+
+static inline NUI_Fixed nui_fixed_clamp(int64_t v) {
+    return (NUI_Fixed)MIN(MAX(v, -NUI_FIXED_MAX), NUI_FIXED_MAX);
+}
+
+static inline NUI_FixedAABB nui_fixed_aabb(NUI_AABB aabb) {
+    return (NUI_FixedAABB){
+        NUI_FIXED_FROM_INT(nui_clamp_coord(aabb.x)),
+        NUI_FIXED_FROM_INT(nui_clamp_coord(aabb.y)),
+        NUI_FIXED_FROM_INT(nui_clamp_coord(aabb.w)),
+        NUI_FIXED_FROM_INT(nui_clamp_coord(aabb.h)),
+    };
+}
+
+// Snaps each edge to the nearest device pixel, so that adjacent rects never
+// overlap or leave gaps between them
+static inline NUI_AABB nui_fixed_snap(NUI_FixedAABB rect) {
+    int x1 = nui_fixed_round(rect.x);
+    int y1 = nui_fixed_round(rect.y);
+    int x2 = nui_fixed_round(rect.x + rect.w);
+    int y2 = nui_fixed_round(rect.y + rect.h);
+    return (NUI_AABB){x1, y1, x2 - x1, y2 - y1};
+}
+
+// Converts a fixed-point length from one scale to another, rounding to the
+// nearest fixed-point step
+static inline NUI_Fixed nui_fixed_rescale(NUI_Fixed v, NUI_Fixed from,
+                                          NUI_Fixed to) {
+    int64_t scaled = (int64_t)v * to;
+    int64_t rounded = scaled >= 0 ? (scaled + from / 2) / from
+                                  : -((-scaled + from / 2) / from);
+    return nui_fixed_clamp(rounded);
+}
+
+// Scales a length in logical pixels to fixed-point device pixels
+static inline NUI_Fixed nui_scale(NUI_Context *ctx, int logical) {
+    return nui_fixed_clamp((int64_t)logical * ctx->scale);
+}
+
+static inline NUI_FixedAABB nui_scale_aabb(NUI_Context *ctx,
+                                           NUI_AABB logical) {
+    return (NUI_FixedAABB){
+        nui_scale(ctx, logical.x),
+        nui_scale(ctx, logical.y),
+        nui_scale(ctx, logical.w),
+        nui_scale(ctx, logical.h),
+    };
+}
+
+// Insets a snapped rect by the border, which is a whole number of device
+// pixels so that it is equally thick on every side
+static inline NUI_AABB nui_border_inset(NUI_Context *ctx, NUI_AABB rect) {
+    int border = nui_fixed_floor(ctx->metrics.border_radius);
+    return (NUI_AABB){rect.x + border, rect.y + border, rect.w - 2 * border,
+                      rect.h - 2 * border};
+}
+
 // FNV-1a hash
 static NUI_Id nui_hash(const char *str, NUI_Id seed) {
     NUI_Id hash = seed ? seed : 2166136261u; // FNV offset basis
@@ -44,6 +157,64 @@ static NUI_Id nui_hash(const char *str, NUI_Id seed) {
     return hash;
 }
 
+// FNV-1a hash over raw bytes, chained through `hash`
+static inline NUI_Id nui_hash_byte(NUI_Id hash, unsigned char byte) {
+    return (hash ^ byte) * 16777619u;
+}
+
+static NUI_Id nui_hash_bytes(const void *data, size_t size, NUI_Id hash) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static NUI_Id nui_hash_aabb(NUI_AABB aabb, int origin_x, int origin_y,
+                           NUI_Id hash) {
+    int values[4] = {aabb.x - origin_x, aabb.y - origin_y, aabb.w, aabb.h};
+    return nui_hash_bytes(values, sizeof(values), hash);
+}
+
+static NUI_Id nui_hash_color(NUI_Color color, NUI_Id hash) {
+    unsigned char values[4] = {color.r, color.g, color.b, color.a};
+    return nui_hash_bytes(values, sizeof(values), hash);
+}
+
+typedef struct {
+    NUI_Id hash;
+    // Interned copy of the measured text, NULL for an empty slot
+    const char *text;
+    int width, height;
+} NUI_TextMetrics;
+
+struct NUI_Resources {
+    // User provided
+    NUI_MeasureTextCallback measure_text;
+    NUI_UserFont font;
+
+    // Device pixels per logical pixel the font measures at, shared by every
+    // context using these resources
+    atomic_int scale;
+
+    // Guards everything below. Never held while calling measure_text, so a
+    // slow font does not stall contexts on other threads.
+    atomic_flag lock;
+
+    // Bumped whenever the cache is cleared, so that text measured before a
+    // scale change is not inserted after it
+    unsigned int generation;
+
+    // Open addressing hash table of measured text
+    NUI_TextMetrics text_cache[NUI_TEXT_CACHE_SIZE];
+    int text_cache_count;
+
+    // Storage for the interned text of the cache entries
+    char text_arena[NUI_TEXT_CACHE_ARENA_SIZE];
+    size_t text_arena_used;
+};
+
 static inline bool nui_aabb_contains(NUI_AABB aabb, int x, int y) {
     return (x >= aabb.x) && (x < aabb.x + aabb.w) && (y >= aabb.y) &&
            (y < aabb.y + aabb.h);
@@ -72,6 +243,295 @@ static inline bool nui_aabb_overlaps(NUI_AABB a, NUI_AABB b) {
            (a.y + a.h > b.y);
 }
 
+static inline NUI_AABBArray nui_aabb_array_offset(NUI_AABBArray array,
+                                                  int offset) {
+    return (NUI_AABBArray){array.x + offset, array.y + offset,
+                           array.w + offset, array.h + offset};
+}
+
+#if defined(NUI_SIMD_SSE2) || defined(NUI_SIMD_NEON) || defined(NUI_SIMD_WASM)
+#define NUI_SIMD
+
+// Four int lanes, with comparisons yielding all bits set in matching lanes
+#if defined(NUI_SIMD_SSE2)
+typedef __m128i NUI_Vec4;
+
+static inline NUI_Vec4 nui_v4_load(const int *p) {
+    return _mm_loadu_si128((const __m128i *)p);
+}
+static inline void nui_v4_store(int *p, NUI_Vec4 v) {
+    _mm_storeu_si128((__m128i *)p, v);
+}
+static inline NUI_Vec4 nui_v4_splat(int v) { return _mm_set1_epi32(v); }
+static inline NUI_Vec4 nui_v4_add(NUI_Vec4 a, NUI_Vec4 b) {
+    return _mm_add_epi32(a, b);
+}
+static inline NUI_Vec4 nui_v4_sub(NUI_Vec4 a, NUI_Vec4 b) {
+    return _mm_sub_epi32(a, b);
+}
+static inline NUI_Vec4 nui_v4_gt(NUI_Vec4 a, NUI_Vec4 b) {
+    return _mm_cmpgt_epi32(a, b);
+}
+static inline NUI_Vec4 nui_v4_and(NUI_Vec4 a, NUI_Vec4 b) {
+    return _mm_and_si128(a, b);
+}
+// a & ~b
+static inline NUI_Vec4 nui_v4_andnot(NUI_Vec4 a, NUI_Vec4 b) {
+    return _mm_andnot_si128(b, a);
+}
+// SSE2 has no 32-bit min/max, select through a comparison instead
+static inline NUI_Vec4 nui_v4_min(NUI_Vec4 a, NUI_Vec4 b) {
+    NUI_Vec4 gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+static inline NUI_Vec4 nui_v4_max(NUI_Vec4 a, NUI_Vec4 b) {
+    NUI_Vec4 gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+// Turns a comparison result into 1 or 0 per lane
+static inline NUI_Vec4 nui_v4_to_bool(NUI_Vec4 mask) {
+    return _mm_srli_epi32(mask, 31);
+}
+// Packs a comparison result into one bit per lane
+static inline int nui_v4_bitmask(NUI_Vec4 mask) {
+    return _mm_movemask_ps(_mm_castsi128_ps(mask));
+}
+#elif defined(NUI_SIMD_NEON)
+typedef int32x4_t NUI_Vec4;
+
+static inline NUI_Vec4 nui_v4_load(const int *p) { return vld1q_s32(p); }
+static inline void nui_v4_store(int *p, NUI_Vec4 v) { vst1q_s32(p, v); }
+static inline NUI_Vec4 nui_v4_splat(int v) { return vdupq_n_s32(v); }
+static inline NUI_Vec4 nui_v4_add(NUI_Vec4 a, NUI_Vec4 b) {
+    return vaddq_s32(a, b);
+}
+static inline NUI_Vec4 nui_v4_sub(NUI_Vec4 a, NUI_Vec4 b) {
+    return vsubq_s32(a, b);
+}
+static inline NUI_Vec4 nui_v4_gt(NUI_Vec4 a, NUI_Vec4 b) {
+    return vreinterpretq_s32_u32(vcgtq_s32(a, b));
+}
+static inline NUI_Vec4 nui_v4_and(NUI_Vec4 a, NUI_Vec4 b) {
+    return vandq_s32(a, b);
+}
+// a & ~b
+static inline NUI_Vec4 nui_v4_andnot(NUI_Vec4 a, NUI_Vec4 b) {
+    return vbicq_s32(a, b);
+}
+static inline NUI_Vec4 nui_v4_min(NUI_Vec4 a, NUI_Vec4 b) {
+    return vminq_s32(a, b);
+}
+static inline NUI_Vec4 nui_v4_max(NUI_Vec4 a, NUI_Vec4 b) {
+    return vmaxq_s32(a, b);
+}
+// Turns a comparison result into 1 or 0 per lane
+static inline NUI_Vec4 nui_v4_to_bool(NUI_Vec4 mask) {
+    return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(mask), 31));
+}
+// Packs a comparison result into one bit per lane
+static inline int nui_v4_bitmask(NUI_Vec4 mask) {
+    int lanes[4];
+    vst1q_s32(lanes, mask);
+    return (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+}
+#elif defined(NUI_SIMD_WASM)
+typedef v128_t NUI_Vec4;
+
+static inline NUI_Vec4 nui_v4_load(const int *p) { return wasm_v128_load(p); }
+static inline void nui_v4_store(int *p, NUI_Vec4 v) { wasm_v128_store(p, v); }
+static inline NUI_Vec4 nui_v4_splat(int v) { return wasm_i32x4_splat(v); }
+static inline NUI_Vec4 nui_v4_add(NUI_Vec4 a, NUI_Vec4 b) {
+    return wasm_i32x4_add(a, b);
+}
+static inline NUI_Vec4 nui_v4_sub(NUI_Vec4 a, NUI_Vec4 b) {
+    return wasm_i32x4_sub(a, b);
+}
+static inline NUI_Vec4 nui_v4_gt(NUI_Vec4 a, NUI_Vec4 b) {
+    return wasm_i32x4_gt(a, b);
+}
+static inline NUI_Vec4 nui_v4_and(NUI_Vec4 a, NUI_Vec4 b) {
+    return wasm_v128_and(a, b);
+}
+// a & ~b
+static inline NUI_Vec4 nui_v4_andnot(NUI_Vec4 a, NUI_Vec4 b) {
+    return wasm_v128_andnot(a, b);
+}
+static inline NUI_Vec4 nui_v4_min(NUI_Vec4 a, NUI_Vec4 b) {
+    return wasm_i32x4_min(a, b);
+}
+static inline NUI_Vec4 nui_v4_max(NUI_Vec4 a, NUI_Vec4 b) {
+    return wasm_i32x4_max(a, b);
+}
+// Turns a comparison result into 1 or 0 per lane
+static inline NUI_Vec4 nui_v4_to_bool(NUI_Vec4 mask) {
+    return wasm_u32x4_shr(mask, 31);
+}
+// Packs a comparison result into one bit per lane
+static inline int nui_v4_bitmask(NUI_Vec4 mask) {
+    return wasm_i32x4_bitmask(mask);
+}
+#endif
+#endif // NUI_SIMD_SSE2 || NUI_SIMD_NEON || NUI_SIMD_WASM
+
+void nui_aabb_clip_batch_scalar(NUI_AABBArray rects, NUI_AABBArray scissors,
+                                NUI_AABBArray out, int *visible, int count) {
+    for (int i = 0; i < count; i++) {
+        NUI_AABB rect = {rects.x[i], rects.y[i], rects.w[i], rects.h[i]};
+        NUI_AABB clip = {scissors.x[i], scissors.y[i], scissors.w[i],
+                         scissors.h[i]};
+        NUI_AABB clipped = nui_aabb_intersects(rect, clip);
+
+        out.x[i] = clipped.x;
+        out.y[i] = clipped.y;
+        out.w[i] = clipped.w;
+        out.h[i] = clipped.h;
+        visible[i] = clipped.w > 0;
+    }
+}
+
+void nui_aabb_clip_batch(NUI_AABBArray rects, NUI_AABBArray scissors,
+                         NUI_AABBArray out, int *visible, int count) {
+    int i = 0;
+#ifdef NUI_SIMD
+    // Same steps as nui_aabb_intersects, four rects at a time
+    for (; i + 4 <= count; i += 4) {
+        NUI_Vec4 rx = nui_v4_load(&rects.x[i]);
+        NUI_Vec4 ry = nui_v4_load(&rects.y[i]);
+        NUI_Vec4 rw = nui_v4_load(&rects.w[i]);
+        NUI_Vec4 rh = nui_v4_load(&rects.h[i]);
+        NUI_Vec4 sx = nui_v4_load(&scissors.x[i]);
+        NUI_Vec4 sy = nui_v4_load(&scissors.y[i]);
+        NUI_Vec4 sw = nui_v4_load(&scissors.w[i]);
+        NUI_Vec4 sh = nui_v4_load(&scissors.h[i]);
+
+        NUI_Vec4 x1 = nui_v4_max(rx, sx);
+        NUI_Vec4 y1 = nui_v4_max(ry, sy);
+        NUI_Vec4 x2 = nui_v4_min(nui_v4_add(rx, rw), nui_v4_add(sx, sw));
+        NUI_Vec4 y2 = nui_v4_min(nui_v4_add(ry, rh), nui_v4_add(sy, sh));
+        NUI_Vec4 mask = nui_v4_and(nui_v4_gt(x2, x1), nui_v4_gt(y2, y1));
+
+        nui_v4_store(&out.x[i], nui_v4_and(x1, mask));
+        nui_v4_store(&out.y[i], nui_v4_and(y1, mask));
+        nui_v4_store(&out.w[i], nui_v4_and(nui_v4_sub(x2, x1), mask));
+        nui_v4_store(&out.h[i], nui_v4_and(nui_v4_sub(y2, y1), mask));
+        nui_v4_store(&visible[i], nui_v4_to_bool(mask));
+    }
+#endif
+
+    // Remaining rects past the last group of four
+    nui_aabb_clip_batch_scalar(
+        nui_aabb_array_offset(rects, i), nui_aabb_array_offset(scissors, i),
+        nui_aabb_array_offset(out, i), visible + i, count - i);
+}
+
+int nui_aabb_hit_test_batch_scalar(NUI_AABBArray rects, int count, int x,
+                                   int y) {
+    for (int i = count - 1; i >= 0; i--) {
+        NUI_AABB rect = {rects.x[i], rects.y[i], rects.w[i], rects.h[i]};
+        if (nui_aabb_contains(rect, x, y))
+            return i;
+    }
+    return -1;
+}
+
+int nui_aabb_hit_test_batch(NUI_AABBArray rects, int count, int x, int y) {
+#ifdef NUI_SIMD
+    // The rects past the last group of four are the highest ones, test them
+    // first
+    int grouped = count & ~3;
+    int hit = nui_aabb_hit_test_batch_scalar(
+        nui_aabb_array_offset(rects, grouped), count - grouped, x, y);
+    if (hit >= 0)
+        return grouped + hit;
+
+    NUI_Vec4 px = nui_v4_splat(x);
+    NUI_Vec4 py = nui_v4_splat(y);
+    for (int i = grouped - 4; i >= 0; i -= 4) {
+        NUI_Vec4 rx = nui_v4_load(&rects.x[i]);
+        NUI_Vec4 ry = nui_v4_load(&rects.y[i]);
+        NUI_Vec4 rw = nui_v4_load(&rects.w[i]);
+        NUI_Vec4 rh = nui_v4_load(&rects.h[i]);
+
+        // x >= rect.x && x < rect.x + rect.w, and the same for y
+        NUI_Vec4 inside_x =
+            nui_v4_andnot(nui_v4_gt(nui_v4_add(rx, rw), px), nui_v4_gt(rx, px));
+        NUI_Vec4 inside_y =
+            nui_v4_andnot(nui_v4_gt(nui_v4_add(ry, rh), py), nui_v4_gt(ry, py));
+        int mask = nui_v4_bitmask(nui_v4_and(inside_x, inside_y));
+        if (mask) {
+            int lane = (mask & 8) ? 3 : (mask & 4) ? 2 : (mask & 2) ? 1 : 0;
+            return i + lane;
+        }
+    }
+    return -1;
+#else
+    return nui_aabb_hit_test_batch_scalar(rects, count, x, y);
+#endif
+}
+
+// Records a primitive drawn by the last command for the next clipping pass
+static inline void nui_clip_record(NUI_Context *ctx, NUI_AABB bounds) {
+    int i = ctx->clip_count++;
+    ctx->clip_bounds.x[i] = bounds.x;
+    ctx->clip_bounds.y[i] = bounds.y;
+    ctx->clip_bounds.w[i] = bounds.w;
+    ctx->clip_bounds.h[i] = bounds.h;
+    ctx->clip_scissors.x[i] = ctx->current_scissors.x;
+    ctx->clip_scissors.y[i] = ctx->current_scissors.y;
+    ctx->clip_scissors.w[i] = ctx->current_scissors.w;
+    ctx->clip_scissors.h[i] = ctx->current_scissors.h;
+    ctx->clip_commands[i] = ctx->command_count - 1;
+}
+
+// Clips the primitives drawn since the last pass against their scissors in
+// one batch, then compacts the commands written since: fully clipped
+// primitives are dropped, rects are trimmed to their scissors, and scissors
+// commands left with nothing to draw are folded into the next one
+static void nui_clip_pending(NUI_Context *ctx) {
+    int count = ctx->clip_count;
+    int start = ctx->clip_start;
+    ctx->clip_count = 0;
+    if (start >= ctx->command_count) {
+        ctx->clip_start = ctx->command_count;
+        return;
+    }
+
+    nui_aabb_clip_batch(ctx->clip_bounds, ctx->clip_scissors, ctx->clip_bounds,
+                        ctx->clip_visible, count);
+
+    int write = start;
+    int entry = 0;
+    for (int read = start; read < ctx->command_count; read++) {
+        NUI_Command cmd = ctx->commands[read];
+        if (entry < count && ctx->clip_commands[entry] == read) {
+            int i = entry++;
+            if (!ctx->clip_visible[i])
+                continue;
+            // Images and text are only culled, trimming them would need
+            // their texture coordinates or glyphs
+            if (cmd.type == NUI_CMD_RECT) {
+                cmd.rect.rect =
+                    (NUI_AABB){ctx->clip_bounds.x[i], ctx->clip_bounds.y[i],
+                               ctx->clip_bounds.w[i], ctx->clip_bounds.h[i]};
+            }
+        }
+
+        if (cmd.type == NUI_CMD_SCISSORS && write > start &&
+            ctx->commands[write - 1].type == NUI_CMD_SCISSORS) {
+            write--;
+        }
+        ctx->commands[write++] = cmd;
+    }
+
+    ctx->command_count = write;
+    ctx->clip_start = write;
+}
+
+static bool nui_reclaim_commands(NUI_Context *ctx) {
+    nui_clip_pending(ctx);
+    return ctx->command_count < ctx->command_capacity;
+}
+
 static inline void nui_push_command_rect(NUI_Context *ctx, NUI_AABB rect,
                                          NUI_Color color) {
     NUI_Command *cmd = NUI_NEXT_COMMAND_SAFE(ctx);
@@ -81,19 +541,38 @@ static inline void nui_push_command_rect(NUI_Context *ctx, NUI_AABB rect,
     cmd->type = NUI_CMD_RECT;
     cmd->rect.rect = rect;
     cmd->rect.color = color;
+    nui_clip_record(ctx, rect);
 }
 
+// The text is culled against the given bounds, NUI_UNBOUNDED when unknown
 static inline void nui_push_command_text(NUI_Context *ctx, const char *text,
-                                         int x, int y, NUI_Color color) {
+                                         int length, NUI_AABB bounds,
+                                         NUI_Color color) {
     NUI_Command *cmd = NUI_NEXT_COMMAND_SAFE(ctx);
     if (!cmd)
         return;
 
     cmd->type = NUI_CMD_TEXT;
     cmd->text.text = text;
-    cmd->text.x = x;
-    cmd->text.y = y;
+    cmd->text.length = length;
+    cmd->text.x = bounds.x;
+    cmd->text.y = bounds.y;
     cmd->text.color = color;
+    nui_clip_record(ctx, bounds);
+}
+
+static inline void nui_push_command_image(NUI_Context *ctx, NUI_AABB rect,
+                                          NUI_UserTexture texture,
+                                          NUI_UVRect uv) {
+    NUI_Command *cmd = NUI_NEXT_COMMAND_SAFE(ctx);
+    if (!cmd)
+        return;
+
+    cmd->type = NUI_CMD_IMAGE;
+    cmd->image.rect = rect;
+    cmd->image.texture = texture;
+    cmd->image.uv = uv;
+    nui_clip_record(ctx, rect);
 }
 
 static inline void nui_push_command_scissors(NUI_Context *ctx, NUI_AABB rect) {
@@ -105,21 +584,107 @@ static inline void nui_push_command_scissors(NUI_Context *ctx, NUI_AABB rect) {
     cmd->scissors.area = rect;
 }
 
-static int nui_compare_containers(const void *a, const void *b) {
-    const NUI_Container *ca = *(const NUI_Container **)a;
-    const NUI_Container *cb = *(const NUI_Container **)b;
+// Hashes a command relative to the given origin, so that moving a container
+// keeps the hash of its content unchanged
+static NUI_Id nui_hash_command(const NUI_Command *cmd, int origin_x,
+                               int origin_y, NUI_Id hash) {
+    hash = nui_hash_bytes(&cmd->type, sizeof(cmd->type), hash);
+
+    switch (cmd->type) {
+    case NUI_CMD_RECT:
+        hash = nui_hash_aabb(cmd->rect.rect, origin_x, origin_y, hash);
+        hash = nui_hash_color(cmd->rect.color, hash);
+        break;
+    case NUI_CMD_TEXT: {
+        int pos[2] = {cmd->text.x - origin_x, cmd->text.y - origin_y};
+        hash = nui_hash_bytes(pos, sizeof(pos), hash);
+        hash = nui_hash_color(cmd->text.color, hash);
+        hash = nui_hash_bytes(cmd->text.text, cmd->text.length, hash);
+    } break;
+    case NUI_CMD_SCISSORS:
+        // The root scissors are not tied to the container's position
+        if (memcmp(&cmd->scissors.area, &NUI_ROOT_SCISSORS,
+                   sizeof(NUI_AABB)) == 0) {
+            hash = nui_hash_aabb(cmd->scissors.area, 0, 0, hash);
+        } else {
+            hash = nui_hash_aabb(cmd->scissors.area, origin_x, origin_y, hash);
+        }
+        break;
+    case NUI_CMD_IMAGE:
+        hash = nui_hash_aabb(cmd->image.rect, origin_x, origin_y, hash);
+        hash = nui_hash_bytes(&cmd->image.texture, sizeof(cmd->image.texture),
+                              hash);
+        hash = nui_hash_bytes(&cmd->image.uv, sizeof(cmd->image.uv), hash);
+        break;
+    case NUI_CMD_CACHED_CONTAINER:
+        hash = nui_hash_bytes(&cmd->cached.id, sizeof(cmd->cached.id), hash);
+        hash = nui_hash_aabb(cmd->cached.area, origin_x, origin_y, hash);
+        hash = nui_hash_bytes(&cmd->cached.dirty, sizeof(cmd->cached.dirty),
+                              hash);
+        hash = nui_hash_bytes(&cmd->cached.command_count,
+                              sizeof(cmd->cached.command_count), hash);
+        break;
+    }
+
+    return hash;
+}
+
+// Moves a command from screen space into a container's local space
+static void nui_translate_command(NUI_Command *cmd, int dx, int dy) {
+    switch (cmd->type) {
+    case NUI_CMD_RECT:
+        cmd->rect.rect.x += dx;
+        cmd->rect.rect.y += dy;
+        break;
+    case NUI_CMD_TEXT:
+        cmd->text.x += dx;
+        cmd->text.y += dy;
+        break;
+    case NUI_CMD_SCISSORS:
+        cmd->scissors.area.x += dx;
+        cmd->scissors.area.y += dy;
+        break;
+    case NUI_CMD_IMAGE:
+        cmd->image.rect.x += dx;
+        cmd->image.rect.y += dy;
+        break;
+    case NUI_CMD_CACHED_CONTAINER:
+        break;
+    }
+}
+
+static inline void nui_z_unlink(NUI_Context *ctx, NUI_Container *container) {
+    if (container->z_above)
+        container->z_above->z_below = container->z_below;
+    else
+        ctx->z_top = container->z_below;
+
+    if (container->z_below)
+        container->z_below->z_above = container->z_above;
+    else
+        ctx->z_bottom = container->z_above;
+
+    container->z_above = NULL;
+    container->z_below = NULL;
+}
 
-    // Lower Z-index first, higher last
-    if (ca->z_index < cb->z_index)
-        return -1;
-    if (ca->z_index > cb->z_index)
-        return 1;
-    return 0;
+static inline void nui_z_link_top(NUI_Context *ctx, NUI_Container *container) {
+    container->z_above = NULL;
+    container->z_below = ctx->z_top;
+    if (ctx->z_top)
+        ctx->z_top->z_above = container;
+    else
+        ctx->z_bottom = container;
+    ctx->z_top = container;
 }
 
 static inline void nui_bring_to_front(NUI_Context *ctx,
                                       NUI_Container *container) {
-    container->z_index = ++ctx->last_z_index;
+    if (ctx->z_top == container)
+        return;
+
+    nui_z_unlink(ctx, container);
+    nui_z_link_top(ctx, container);
 }
 
 static NUI_Container *nui_get_container(NUI_Context *ctx, NUI_Id id) {
@@ -130,31 +695,256 @@ static NUI_Container *nui_get_container(NUI_Context *ctx, NUI_Id id) {
         }
     }
 
-    // Create new container
-    assert(ctx->container_count < NUI_CONTAINER_LIST_SIZE &&
-           "container list overflow");
+    // Create new container, unless the list is full
+    if (ctx->container_count >= NUI_CONTAINER_LIST_SIZE) {
+        ctx->limits.container_overflows++;
+        return NULL;
+    }
 
     NUI_Container *container = &ctx->container_list[ctx->container_count++];
     memset(container, 0, sizeof(*container));
     container->id = id;
-    nui_bring_to_front(ctx, container);
+    nui_z_link_top(ctx, container);
 
     return container;
 }
 
+NUI_Resources *nui_resources_create(NUI_MeasureTextCallback measure_text,
+                                    NUI_UserFont font) {
+    assert(measure_text && "measure_text must not be NULL");
+
+    NUI_Resources *resources = calloc(1, sizeof(*resources));
+    if (!resources)
+        return NULL;
+
+    resources->measure_text = measure_text;
+    resources->font = font;
+    atomic_init(&resources->scale, NUI_FIXED_ONE);
+    atomic_flag_clear(&resources->lock);
+    return resources;
+}
+
+void nui_resources_destroy(NUI_Resources *resources) { free(resources); }
+
+static inline void nui_resources_lock(NUI_Resources *resources) {
+    while (atomic_flag_test_and_set_explicit(&resources->lock,
+                                             memory_order_acquire)) {
+    }
+}
+
+static inline void nui_resources_unlock(NUI_Resources *resources) {
+    atomic_flag_clear_explicit(&resources->lock, memory_order_release);
+}
+
+// Measures text with the user's callback, clamping the result so that it can
+// take part in layout math
+static void nui_measure_user_text(NUI_Resources *resources, const char *text,
+                                  int *out_width, int *out_height) {
+    resources->measure_text(resources->font, text, out_width, out_height);
+    *out_width = nui_clamp_coord(MAX(*out_width, 0));
+    *out_height = nui_clamp_coord(MAX(*out_height, 0));
+}
+
+// Finds the slot holding the given text, or the empty slot it belongs in
+static NUI_TextMetrics *nui_text_cache_find(NUI_Resources *resources,
+                                            const char *text, NUI_Id hash) {
+    unsigned int index = hash & (NUI_TEXT_CACHE_SIZE - 1);
+    for (;;) {
+        NUI_TextMetrics *slot = &resources->text_cache[index];
+        if (!slot->text ||
+            (slot->hash == hash && strcmp(slot->text, text) == 0)) {
+            return slot;
+        }
+        index = (index + 1) & (NUI_TEXT_CACHE_SIZE - 1);
+    }
+}
+
+void nui_resources_measure_text(NUI_Resources *resources, const char *text,
+                                int *out_width, int *out_height) {
+    NUI_Id hash = nui_hash(text, 0);
+
+    nui_resources_lock(resources);
+    NUI_TextMetrics *slot = nui_text_cache_find(resources, text, hash);
+    if (slot->text) {
+        *out_width = slot->width;
+        *out_height = slot->height;
+        nui_resources_unlock(resources);
+        return;
+    }
+    unsigned int generation = resources->generation;
+    nui_resources_unlock(resources);
+
+    nui_measure_user_text(resources, text, out_width, out_height);
+
+    // Intern the text and cache its metrics, unless another thread did so
+    // meanwhile, the scale changed or the cache is full in which case the
+    // text keeps being measured on every call. The table is kept at most 3/4
+    // full so probing stays short and always terminates.
+    nui_resources_lock(resources);
+    slot = nui_text_cache_find(resources, text, hash);
+    size_t size = strlen(text) + 1;
+    if (!slot->text && resources->generation == generation &&
+        resources->text_cache_count < NUI_TEXT_CACHE_SIZE / 4 * 3 &&
+        resources->text_arena_used + size <= NUI_TEXT_CACHE_ARENA_SIZE) {
+        char *interned = &resources->text_arena[resources->text_arena_used];
+        memcpy(interned, text, size);
+        resources->text_arena_used += size;
+
+        slot->hash = hash;
+        slot->text = interned;
+        slot->width = *out_width;
+        slot->height = *out_height;
+        resources->text_cache_count++;
+    }
+    nui_resources_unlock(resources);
+}
+
+// Sets the scale the resources' font measures at, dropping the text measured
+// at the previous one
+static void nui_resources_set_scale(NUI_Resources *resources,
+                                    NUI_Fixed scale) {
+    nui_resources_lock(resources);
+    if (atomic_load(&resources->scale) != scale) {
+        atomic_store(&resources->scale, scale);
+        memset(resources->text_cache, 0, sizeof(resources->text_cache));
+        resources->text_cache_count = 0;
+        resources->text_arena_used = 0;
+        resources->generation++;
+    }
+    nui_resources_unlock(resources);
+}
+
 void nui_init(NUI_Context *ctx, NUI_MeasureTextCallback measure_text,
               NUI_UserFont font) {
-    assert(measure_text && "measure_text must not be NULL");
-    ctx->measure_text = measure_text;
-    ctx->font = font;
-    ctx->style = nui_default_style;
+    nui_init_shared(ctx, nui_resources_create(measure_text, font));
+    ctx->owns_resources = true;
+}
+
+void nui_init_shared(NUI_Context *ctx, NUI_Resources *resources) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->resources = resources;
+    ctx->scale = resources ? atomic_load(&resources->scale) : NUI_FIXED_ONE;
+    nui_set_style(ctx, nui_default_style);
+
+    // The clipping pass keeps ten int arrays of primitives, at most one per
+    // command. Without them or the resources the context is left without a
+    // command buffer, see nui_context_failed.
+    if (!resources)
+        return;
+    int n = NUI_MAX_COMMANDS;
+    ctx->commands = malloc(n * sizeof(*ctx->commands));
+    int *clip = malloc(n * 10 * sizeof(int));
+    if (ctx->commands && clip) {
+        ctx->command_capacity = n;
+        ctx->clip_bounds =
+            (NUI_AABBArray){clip, clip + n, clip + 2 * n, clip + 3 * n};
+        ctx->clip_scissors = (NUI_AABBArray){clip + 4 * n, clip + 5 * n,
+                                             clip + 6 * n, clip + 7 * n};
+        ctx->clip_visible = clip + 8 * n;
+        ctx->clip_commands = clip + 9 * n;
+    } else {
+        free(ctx->commands);
+        ctx->commands = NULL;
+        free(clip);
+    }
+}
+
+void nui_destroy(NUI_Context *ctx) {
+    for (int i = 0; i < ctx->text_layout_count; i++) {
+        free(ctx->text_layouts[i].lines);
+    }
+    free(ctx->text_layouts);
+    free(ctx->word_widths);
+    free(ctx->commands);
+    free(ctx->clip_bounds.x);
+    if (ctx->owns_resources) {
+        nui_resources_destroy(ctx->resources);
+    }
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+// Whether nui_init failed to allocate the resources or the command buffer, in
+// which case the context draws nothing and counts an allocation failure
+// every frame
+static inline bool nui_context_failed(NUI_Context *ctx) {
+    return ctx->command_capacity == 0;
+}
+
+static void nui_update_metrics(NUI_Context *ctx) {
+    ctx->metrics.border_radius = NUI_FIXED_FROM_INT(
+        nui_fixed_round(nui_scale(ctx, ctx->style.border_radius)));
+    ctx->metrics.padding_x = nui_scale(ctx, ctx->style.padding_x);
+    ctx->metrics.padding_y = nui_scale(ctx, ctx->style.padding_y);
+    ctx->metrics.margin = nui_scale(ctx, ctx->style.margin);
+    ctx->metrics.title_text_height =
+        nui_scale(ctx, ctx->style.title_text_height);
+}
+
+void nui_set_style(NUI_Context *ctx, NUI_Style style) {
+    ctx->style = style;
+    nui_update_metrics(ctx);
+}
+
+// Switches the context to the given scale, resizing the retained window
+// areas as if they had been created at it and dropping the line breaks
+// wrapped with text measured at the previous one
+static void nui_apply_scale(NUI_Context *ctx, NUI_Fixed scale) {
+    if (ctx->scale == scale)
+        return;
+
+    NUI_Fixed old_scale = ctx->scale;
+    NUI_Fixed old_title_h =
+        ctx->metrics.padding_y * 2 + ctx->metrics.title_text_height;
+    ctx->scale = scale;
+    nui_update_metrics(ctx);
+    NUI_Fixed title_h =
+        ctx->metrics.padding_y * 2 + ctx->metrics.title_text_height;
+
+    // The title bar is sized by the style, only the rest of the window
+    // scales with its area
+    for (int i = 0; i < ctx->container_count; i++) {
+        NUI_Container *container = &ctx->container_list[i];
+        if (container->area.w == 0)
+            continue;
+        NUI_FixedAABB area = nui_fixed_aabb(container->area);
+        NUI_Fixed body_h = MAX(area.h - old_title_h, 0);
+        NUI_FixedAABB scaled = {
+            nui_fixed_rescale(area.x, old_scale, scale),
+            nui_fixed_rescale(area.y, old_scale, scale),
+            nui_fixed_rescale(area.w, old_scale, scale),
+            nui_fixed_rescale(body_h, old_scale, scale) + title_h,
+        };
+        container->area = nui_fixed_snap(scaled);
+    }
+
+    for (int i = 0; i < ctx->text_layout_count; i++) {
+        NUI_TextLayout *layout = &ctx->text_layouts[i];
+        layout->text = NULL;
+        layout->length = -1;
+        layout->line_count = 0;
+    }
+    if (ctx->word_widths) {
+        memset(ctx->word_widths, 0,
+               NUI_WORD_CACHE_SIZE * sizeof(*ctx->word_widths));
+    }
 }
 
-void nui_set_style(NUI_Context *ctx, NUI_Style style) { ctx->style = style; }
+void nui_set_scale(NUI_Context *ctx, float scale) {
+    assert(scale > 0 && "scale must be positive");
+    // Written so that NaN ends up at the minimum as well
+    if (!(scale >= NUI_MIN_SCALE))
+        scale = NUI_MIN_SCALE;
+    if (scale > NUI_MAX_SCALE)
+        scale = NUI_MAX_SCALE;
+    NUI_Fixed fixed = (NUI_Fixed)(scale * NUI_FIXED_ONE + 0.5f);
+    if (ctx->resources)
+        nui_resources_set_scale(ctx->resources, fixed);
+    nui_apply_scale(ctx, fixed);
+}
 
 void nui_input_mouse_move(NUI_Context *ctx, int x, int y) {
-    ctx->input.mouse_x = x;
-    ctx->input.mouse_y = y;
+    ctx->input.mouse_x = nui_clamp_coord(x);
+    ctx->input.mouse_y = nui_clamp_coord(y);
 }
 
 void nui_input_mouse_button(NUI_Context *ctx, bool down) {
@@ -172,118 +962,184 @@ void nui_frame_begin(NUI_Context *ctx) {
     ctx->input.mouse_pressed_queued = false;
     ctx->input.mouse_released_queued = false;
 
+    // Follow a scale set through another context sharing the resources
+    if (ctx->resources)
+        nui_apply_scale(ctx, atomic_load(&ctx->resources->scale));
+
     // Reset render state
     ctx->command_count = 0;
+    ctx->clip_count = 0;
+    ctx->clip_start = 0;
+    memset(&ctx->limits, 0, sizeof(ctx->limits));
+    if (nui_context_failed(ctx))
+        ctx->limits.allocation_failures++;
+    ctx->frame_index++;
 
     ctx->hot = 0;
 
     ctx->scissors_stack_top = 0;
+    ctx->scissors_overflow_depth = 0;
     ctx->current_scissors = NUI_ROOT_SCISSORS;
 
     ctx->layout_stack_top = 0;
+    ctx->layout_overflow_depth = 0;
     memset(&ctx->layout, 0, sizeof(ctx->layout));
 
-    // Find hovered container
-    ctx->hover_container_id = 0;
-    int best_z = -1;
-    for (int i = 0; i < ctx->container_count; i++) {
-        NUI_Container *c = &ctx->container_list[i];
-        if (c->command_count > 0 &&
-            nui_aabb_contains(c->area, ctx->input.mouse_x,
-                              ctx->input.mouse_y)) {
-            if (c->z_index > best_z) {
-                best_z = c->z_index;
-                ctx->hover_container_id = c->id;
-            }
+    // Gather the containers drawn last frame in z-order, to find the
+    // top-most hovered one in a single hit test
+    NUI_Container *drawn[NUI_CONTAINER_LIST_SIZE];
+    int x[NUI_CONTAINER_LIST_SIZE], y[NUI_CONTAINER_LIST_SIZE];
+    int w[NUI_CONTAINER_LIST_SIZE], h[NUI_CONTAINER_LIST_SIZE];
+    int drawn_count = 0;
+    for (NUI_Container *c = ctx->z_bottom; c; c = c->z_above) {
+        if (c->command_count > 0) {
+            x[drawn_count] = c->area.x;
+            y[drawn_count] = c->area.y;
+            w[drawn_count] = c->area.w;
+            h[drawn_count] = c->area.h;
+            drawn[drawn_count++] = c;
         }
 
         // Reset command count from last frame
         c->command_count = 0;
     }
+
+    int hovered = nui_aabb_hit_test_batch((NUI_AABBArray){x, y, w, h},
+                                          drawn_count, ctx->input.mouse_x,
+                                          ctx->input.mouse_y);
+    ctx->hover_container_id = hovered >= 0 ? drawn[hovered]->id : 0;
 }
 
 void nui_frame_end(NUI_Context *ctx) {
+    nui_clip_pending(ctx);
+
     if (ctx->input.mouse_released) {
         ctx->active = 0;
     }
 
-    // Sort containers by Z-index for rendering
-    ctx->sorted_count = 0;
-    for (int i = 0; i < ctx->container_count; i++) {
-        if (ctx->container_list[i].command_count > 0) {
-            ctx->sorted_containers[ctx->sorted_count++] =
-                &ctx->container_list[i];
-        }
-    }
-    qsort(ctx->sorted_containers, ctx->sorted_count,
-          sizeof(*ctx->sorted_containers), nui_compare_containers);
-
-    // Reset command draining iteration state
-    ctx->iter_container_index = 0;
+    // Reset command draining iteration state, containers are already kept
+    // in z-order so drawing starts from the bottom-most one
+    ctx->iter_container = ctx->z_bottom;
     ctx->iter_cmd_offset = 0;
 }
 
-void nui_scissors_push(NUI_Context *ctx, NUI_AABB area) {
-    assert(ctx->scissors_stack_top < NUI_SCISSORS_STACK_SIZE &&
-           "scissors stack overflow");
+// Pushes the current scissors onto the stack, returns false if the push is
+// ignored as the stack is full
+static bool nui_scissors_save(NUI_Context *ctx) {
+    if (ctx->scissors_overflow_depth > 0 ||
+        ctx->scissors_stack_top >= NUI_SCISSORS_STACK_SIZE) {
+        ctx->limits.scissors_overflows++;
+        ctx->scissors_overflow_depth++;
+        return false;
+    }
 
-    // Push current scissors onto stack
     ctx->scissors_stack[ctx->scissors_stack_top++] = ctx->current_scissors;
+    return true;
+}
+
+// Pops the current scissors off the stack, returns false if there was
+// nothing to pop
+static bool nui_scissors_restore(NUI_Context *ctx) {
+    // Match the pushes that were ignored first
+    if (ctx->scissors_overflow_depth > 0) {
+        ctx->scissors_overflow_depth--;
+        return false;
+    }
+    if (ctx->scissors_stack_top <= 0) {
+        ctx->limits.scissors_underflows++;
+        return false;
+    }
+
+    ctx->current_scissors = ctx->scissors_stack[--ctx->scissors_stack_top];
+    return true;
+}
+
+static void nui_scissors_push_device(NUI_Context *ctx, NUI_AABB area) {
+    if (!nui_scissors_save(ctx))
+        return;
+
     // Intersect with new area and set as current scissors
     ctx->current_scissors = nui_aabb_intersects(ctx->current_scissors, area);
     nui_push_command_scissors(ctx, ctx->current_scissors);
 }
 
+void nui_scissors_push(NUI_Context *ctx, NUI_AABB area) {
+    nui_scissors_push_device(ctx, nui_fixed_snap(nui_scale_aabb(ctx, area)));
+}
+
 void nui_scissors_pop(NUI_Context *ctx) {
-    assert(ctx->scissors_stack_top > 0 && "scissors stack underflow");
+    if (nui_scissors_restore(ctx))
+        nui_push_command_scissors(ctx, ctx->current_scissors);
+}
 
-    ctx->current_scissors = ctx->scissors_stack[--ctx->scissors_stack_top];
-    nui_push_command_scissors(ctx, ctx->current_scissors);
+static inline void nui_layout_next_row(NUI_Layout *layout) {
+    layout->cursor_x = layout->start_x;
+    layout->cursor_y = nui_fixed_clamp((int64_t)layout->cursor_y +
+                                       layout->row_height + layout->margin);
+    layout->row_height = 0;
+    layout->column_index = 0;
 }
 
-static NUI_AABB nui_layout_allocate(NUI_Context *ctx, int w, int h) {
+static NUI_FixedAABB nui_layout_allocate(NUI_Context *ctx, NUI_Fixed w,
+                                         NUI_Fixed h) {
     NUI_Layout *layout = &ctx->layout;
 
-    // Handle wrapping for horizontal layout if exceeding available width
-    if (layout->mode == NUI_LAYOUT_HORIZONTAL) {
-        int right_edge = layout->cursor_x + w;
-        int max_edge = layout->start_x + layout->width;
+    if (layout->column_count > 0) {
+        // Take the size of the current column of the row spec
+        w = layout->columns[layout->column_index];
+        if (layout->column_height > 0)
+            h = layout->column_height;
+    } else if (layout->mode == NUI_LAYOUT_HORIZONTAL) {
+        // Handle wrapping for horizontal layout if exceeding available width
+        NUI_Fixed right_edge = layout->cursor_x + w;
+        NUI_Fixed max_edge = layout->start_x + layout->width;
 
         if (right_edge > max_edge) {
-            layout->cursor_x = layout->start_x;
-            layout->cursor_y += layout->row_height + layout->margin;
-            layout->row_height = 0;
+            nui_layout_next_row(layout);
         }
     }
 
     // Compute the rectangle to allocate
-    NUI_AABB rect = {layout->cursor_x, layout->cursor_y, w, h};
+    NUI_FixedAABB rect = {layout->cursor_x, layout->cursor_y, w, h};
 
     // Track the tallest item in the current row for horizontal layout
     if (h > layout->row_height)
         layout->row_height = h;
 
     // Update the total occupied size of the layout
-    int occupied_x = (rect.x + rect.w) - layout->start_x;
-    int occupied_y = (rect.y + rect.h) - layout->start_y;
+    NUI_Fixed occupied_x = (rect.x + rect.w) - layout->start_x;
+    NUI_Fixed occupied_y = (rect.y + rect.h) - layout->start_y;
     if (occupied_x > layout->size_x)
         layout->size_x = occupied_x;
     if (occupied_y > layout->size_y)
         layout->size_y = occupied_y;
 
-    // Advance the cursor for the next allocation
-    if (layout->mode == NUI_LAYOUT_VERTICAL) {
-        layout->cursor_y += h + layout->margin;
+    // Advance the cursor for the next allocation, clamped so that however
+    // many items are laid out it stays within the fixed-point range
+    if (layout->column_count > 0) {
+        layout->cursor_x =
+            nui_fixed_clamp((int64_t)layout->cursor_x + w + layout->margin);
+        if (++layout->column_index == layout->column_count)
+            nui_layout_next_row(layout);
+    } else if (layout->mode == NUI_LAYOUT_VERTICAL) {
+        layout->cursor_y =
+            nui_fixed_clamp((int64_t)layout->cursor_y + h + layout->margin);
     } else {
-        layout->cursor_x += w + layout->margin;
+        layout->cursor_x =
+            nui_fixed_clamp((int64_t)layout->cursor_x + w + layout->margin);
     }
 
     return rect;
 }
 
-void nui_layout_push(NUI_Context *ctx, NUI_AABB area, NUI_LayoutMode mode) {
-    assert(ctx->layout_stack_top < NUI_LAYOUT_STACK_SIZE &&
-           "layout stack overflow");
+static void nui_layout_push_fixed(NUI_Context *ctx, NUI_FixedAABB area,
+                                  NUI_LayoutMode mode) {
+    if (ctx->layout_overflow_depth > 0 ||
+        ctx->layout_stack_top >= NUI_LAYOUT_STACK_SIZE) {
+        ctx->limits.layout_overflows++;
+        ctx->layout_overflow_depth++;
+        return;
+    }
 
     ctx->layout_stack[ctx->layout_stack_top++] = ctx->layout;
 
@@ -294,12 +1150,27 @@ void nui_layout_push(NUI_Context *ctx, NUI_AABB area, NUI_LayoutMode mode) {
     ctx->layout.size_x = 0;
     ctx->layout.size_y = 0;
     ctx->layout.width = area.w;
-    ctx->layout.margin = ctx->style.margin;
+    ctx->layout.row_height = 0;
+    ctx->layout.margin = ctx->metrics.margin;
     ctx->layout.mode = mode;
+    ctx->layout.column_count = 0;
+    ctx->layout.column_index = 0;
+}
+
+void nui_layout_push(NUI_Context *ctx, NUI_AABB area, NUI_LayoutMode mode) {
+    nui_layout_push_fixed(ctx, nui_scale_aabb(ctx, area), mode);
 }
 
 void nui_layout_pop(NUI_Context *ctx) {
-    assert(ctx->layout_stack_top > 0 && "layout stack underflow");
+    // Match the pushes that were ignored first
+    if (ctx->layout_overflow_depth > 0) {
+        ctx->layout_overflow_depth--;
+        return;
+    }
+    if (ctx->layout_stack_top <= 0) {
+        ctx->limits.layout_underflows++;
+        return;
+    }
 
     NUI_Layout child = ctx->layout;
     ctx->layout = ctx->layout_stack[--ctx->layout_stack_top];
@@ -307,25 +1178,101 @@ void nui_layout_pop(NUI_Context *ctx) {
     nui_layout_allocate(ctx, child.size_x, child.size_y);
 }
 
-bool nui_window_begin(NUI_Context *ctx, const char *title, NUI_AABB area) {
+static inline int nui_fill_weight(NUI_Size size) {
+    return MIN(MAX(size.value, 0), NUI_MAX_FILL_WEIGHT);
+}
+
+void nui_layout_row(NUI_Context *ctx, int count, const NUI_Size *columns,
+                    int height) {
+    if (count > NUI_LAYOUT_MAX_COLUMNS) {
+        ctx->limits.column_overflows++;
+        count = NUI_LAYOUT_MAX_COLUMNS;
+    }
+    if (count < 0)
+        count = 0;
+    NUI_Layout *layout = &ctx->layout;
+
+    // Start on a fresh row, unless the cursor is already at one
+    if (layout->column_index > 0 ||
+        (layout->column_count == 0 && layout->mode == NUI_LAYOUT_HORIZONTAL &&
+         layout->cursor_x != layout->start_x)) {
+        nui_layout_next_row(layout);
+    }
+    layout->cursor_x = layout->start_x;
+    layout->row_height = 0;
+
+    layout->column_count = count;
+    layout->column_index = 0;
+    layout->column_height = nui_scale(ctx, height);
+
+    // Resolve pixel and percent columns first, then share what is left
+    // between fill columns by weight
+    NUI_Fixed available = layout->width - layout->margin * (count - 1);
+    if (available < 0)
+        available = 0;
+    NUI_Fixed remaining = available;
+    int fill_weight = 0;
+    for (int i = 0; i < count; i++) {
+        NUI_Fixed width = 0;
+        switch (columns[i].kind) {
+        case NUI_SIZE_PIXELS:
+            width = nui_scale(ctx, columns[i].value);
+            break;
+        case NUI_SIZE_PERCENT:
+            width = (NUI_Fixed)((int64_t)available *
+                                MIN(MAX(columns[i].value, 0), 100) / 100);
+            break;
+        case NUI_SIZE_FILL:
+            fill_weight += nui_fill_weight(columns[i]);
+            break;
+        }
+        layout->columns[i] = width;
+        remaining -= width;
+    }
+
+    if (remaining < 0)
+        remaining = 0;
+    for (int i = 0; i < count && fill_weight > 0; i++) {
+        if (columns[i].kind != NUI_SIZE_FILL)
+            continue;
+
+        // The last fill column takes the rounding remainder
+        int weight = nui_fill_weight(columns[i]);
+        NUI_Fixed width =
+            (NUI_Fixed)((int64_t)remaining * weight / fill_weight);
+        fill_weight -= weight;
+        remaining -= width;
+        layout->columns[i] = width;
+    }
+}
+
+bool nui_window_begin(NUI_Context *ctx, const char *title, NUI_AABB area,
+                      int flags) {
+    if (nui_context_failed(ctx))
+        return false;
     NUI_Id id = nui_hash(title, 0);
     NUI_Container *container = nui_get_container(ctx, id);
+    if (!container)
+        return false;
+    container->flags = flags;
+    container->cache_dirty = false;
 
-    int title_h = ctx->style.padding_y * 2 + 16;
+    const NUI_StyleMetrics *metrics = &ctx->metrics;
+    NUI_Fixed title_h = metrics->padding_y * 2 + metrics->title_text_height;
 
-    // Initialize container area on first use
+    // Initialize container area on first use, in device pixels. Scale
+    // changes resize it from then on, see nui_apply_scale.
     if (container->area.w == 0) {
-        container->area = area;
-        container->area.h += title_h;
+        NUI_FixedAABB scaled = nui_scale_aabb(ctx, area);
+        scaled.w = MAX(scaled.w, 0);
+        scaled.h = MAX(scaled.h, 0) + title_h;
+        container->area = nui_fixed_snap(scaled);
     }
 
     // Calculate title bar area
-    NUI_AABB title_area = {
-        container->area.x,
-        container->area.y,
-        container->area.w,
-        title_h,
-    };
+    NUI_FixedAABB title_fixed = nui_fixed_aabb(container->area);
+    title_fixed.h = title_h;
+    NUI_AABB title_area = nui_fixed_snap(title_fixed);
 
     // Dragging and focus handling
     bool hovered =
@@ -337,8 +1284,12 @@ bool nui_window_begin(NUI_Context *ctx, const char *title, NUI_AABB area) {
     if (ctx->active == id) {
         // Window is being dragged
         if (ctx->input.mouse_down) {
-            container->area.x = ctx->input.mouse_x - ctx->input.drag_offset_x;
-            container->area.y = ctx->input.mouse_y - ctx->input.drag_offset_y;
+            // Keep the window where its position still fits the layout
+            // math, however far it is dragged
+            container->area.x = nui_clamp_coord(
+                (int64_t)ctx->input.mouse_x - ctx->input.drag_offset_x);
+            container->area.y = nui_clamp_coord(
+                (int64_t)ctx->input.mouse_y - ctx->input.drag_offset_y);
             title_area.x = container->area.x;
             title_area.y = container->area.y;
         } else {
@@ -353,71 +1304,147 @@ bool nui_window_begin(NUI_Context *ctx, const char *title, NUI_AABB area) {
     }
 
     // Calculate area below title bar
-    NUI_AABB body_area = {
-        container->area.x,
-        container->area.y + title_h,
-        container->area.w,
-        container->area.h - title_h,
+    NUI_FixedAABB window = nui_fixed_aabb(container->area);
+    NUI_FixedAABB body = {
+        window.x,
+        window.y + title_h,
+        window.w,
+        window.h - title_h,
     };
     // Calculate area inside margins
-    NUI_AABB content_area = {
-        body_area.x + ctx->style.margin,
-        body_area.y + ctx->style.margin,
-        body_area.w - (ctx->style.margin * 2),
-        body_area.h - (ctx->style.margin * 2),
+    NUI_FixedAABB content = {
+        body.x + metrics->margin,
+        body.y + metrics->margin,
+        body.w - (metrics->margin * 2),
+        body.h - (metrics->margin * 2),
     };
+    NUI_AABB body_area = nui_fixed_snap(body);
+    NUI_AABB content_area = nui_fixed_snap(content);
 
     // Skip rendering if window is outside current scissors
     if (!nui_aabb_overlaps(content_area, ctx->current_scissors)) {
         return false;
     }
 
+    // Clip what is left of a window that was not ended
+    nui_clip_pending(ctx);
+
     // Initialize the command slice for this container
     container->command_start_index = ctx->command_count;
     container->command_count = 0;
     // Set as active container to track command count
     ctx->current_container = container;
 
+    // Reserve a header command that references the cached target, filled in
+    // once the content hash is known in nui_window_end
+    if (flags & NUI_WINDOW_CACHED) {
+        NUI_Command *header = NUI_NEXT_COMMAND_SAFE(ctx);
+        if (header)
+            header->type = NUI_CMD_CACHED_CONTAINER;
+        else
+            container->flags &= ~NUI_WINDOW_CACHED;
+    }
+    ctx->clip_start = ctx->command_count;
+
+    // Clip cached windows to their own area rather than to the screen, so
+    // that their content only depends on their position through the offset
+    // it is hashed and drawn relative to
+    if ((container->flags & NUI_WINDOW_CACHED) && nui_scissors_save(ctx)) {
+        ctx->current_scissors = container->area;
+    }
+
     // Render title bar and window background
     nui_push_command_rect(ctx, title_area, ctx->style.window_title_bar);
-    nui_scissors_push(ctx, title_area);
-    nui_push_command_text(ctx, title, title_area.x + ctx->style.padding_x,
-                          title_area.y + ctx->style.padding_y, ctx->style.text);
+    nui_scissors_push_device(ctx, title_area);
+    NUI_AABB title_bounds = {nui_fixed_floor(window.x + metrics->padding_x),
+                             nui_fixed_floor(window.y + metrics->padding_y),
+                             NUI_UNBOUNDED, NUI_UNBOUNDED};
+    nui_push_command_text(ctx, title, (int)strlen(title), title_bounds,
+                          ctx->style.text);
     nui_scissors_pop(ctx);
 
     // Prepare content area and layout
     nui_push_command_rect(ctx, body_area, ctx->style.window_bg);
-    nui_scissors_push(ctx, content_area);
-    nui_layout_push(ctx, content_area, NUI_LAYOUT_VERTICAL);
+    nui_scissors_push_device(ctx, content_area);
+    nui_layout_push_fixed(ctx, content, NUI_LAYOUT_VERTICAL);
 
     return true;
 }
 
+static void nui_finalize_cached_container(NUI_Context *ctx,
+                                         NUI_Container *container) {
+    NUI_Command *header = &ctx->commands[container->command_start_index];
+    NUI_Command *content = header + 1;
+    int content_count = container->command_count - 1;
+
+    NUI_Id hash = nui_hash_bytes(&container->area.w, sizeof(int), 2166136261u);
+    hash = nui_hash_bytes(&container->area.h, sizeof(int), hash);
+    for (int i = 0; i < content_count; i++) {
+        hash = nui_hash_command(&content[i], container->area.x,
+                                container->area.y, hash);
+    }
+
+    container->cache_dirty =
+        !container->cache_valid || container->cache_hash != hash;
+    container->cache_hash = hash;
+    container->cache_valid = true;
+
+    header->cached.id = container->id;
+    header->cached.area = container->area;
+    header->cached.dirty = container->cache_dirty;
+
+    if (container->cache_dirty) {
+        header->cached.command_count = content_count;
+    } else {
+        // Content is unchanged, drop it and only emit the header. The slice
+        // is always the last one written so its commands can be reclaimed.
+        header->cached.command_count = 0;
+        container->command_count = 1;
+        ctx->command_count = container->command_start_index + 1;
+    }
+}
+
 void nui_window_end(NUI_Context *ctx) {
     nui_scissors_pop(ctx);
     nui_layout_pop(ctx);
 
     // Finalize command count for the active container
-    if (ctx->current_container) {
-        ctx->current_container->command_count =
-            ctx->command_count - ctx->current_container->command_start_index;
+    NUI_Container *container = ctx->current_container;
+    if (container) {
+        // Leave the window's own clipping without emitting the scissors
+        // outside, which the cached target never draws with
+        if (container->flags & NUI_WINDOW_CACHED)
+            nui_scissors_restore(ctx);
+
+        nui_clip_pending(ctx);
+        container->command_count =
+            ctx->command_count - container->command_start_index;
         ctx->current_container = NULL;
+
+        if ((container->flags & NUI_WINDOW_CACHED) &&
+            container->command_count > 0) {
+            nui_finalize_cached_container(ctx, container);
+        }
     }
 }
 
 bool nui_button(NUI_Context *ctx, const char *label) {
     if (!ctx->current_container) {
-        assert("nui_button called without a parent container" && 0);
+        ctx->limits.orphan_widgets++;
         return false;
     }
     NUI_Id id = nui_hash(label, ctx->current_container->id);
 
     // Derive position size based on current layout
     int text_w, text_h;
-    ctx->measure_text(ctx->font, label, &text_w, &text_h);
-    int button_w = text_w + (ctx->style.padding_x * 2);
-    int button_h = text_h + (ctx->style.padding_y * 2);
-    NUI_AABB area = nui_layout_allocate(ctx, button_w, button_h);
+    nui_resources_measure_text(ctx->resources, label, &text_w, &text_h);
+    const NUI_StyleMetrics *metrics = &ctx->metrics;
+    NUI_Fixed text_w_fixed = NUI_FIXED_FROM_INT(text_w);
+    NUI_Fixed text_h_fixed = NUI_FIXED_FROM_INT(text_h);
+    NUI_FixedAABB area_fixed =
+        nui_layout_allocate(ctx, text_w_fixed + (metrics->padding_x * 2),
+                            text_h_fixed + (metrics->padding_y * 2));
+    NUI_AABB area = nui_fixed_snap(area_fixed);
 
     // Hover and click
     bool is_top_window =
@@ -435,6 +1462,8 @@ bool nui_button(NUI_Context *ctx, const char *label) {
         ctx->active = id;
     }
 
+    bool clicked = (ctx->active == id && ctx->input.mouse_released);
+
     // Render button
     NUI_Color color = ctx->style.button_idle;
     if (ctx->active == id) {
@@ -446,39 +1475,427 @@ bool nui_button(NUI_Context *ctx, const char *label) {
     // Draw border (outer rect)
     nui_push_command_rect(ctx, area, ctx->style.border);
     // Draw button (inner rect, inset by border_radius)
-    NUI_AABB inner_rect = {area.x + ctx->style.border_radius,
-                           area.y + ctx->style.border_radius,
-                           area.w - 2 * ctx->style.border_radius,
-                           area.h - 2 * ctx->style.border_radius};
+    NUI_AABB inner_rect = nui_border_inset(ctx, area);
+    NUI_FixedAABB inner = nui_fixed_aabb(inner_rect);
     nui_push_command_rect(ctx, inner_rect, color);
-    nui_scissors_push(ctx, inner_rect);
-    nui_push_command_text(
-        ctx, label, inner_rect.x + (inner_rect.w - text_w) / 2,
-        inner_rect.y + (inner_rect.h - text_h) / 2, ctx->style.text);
+    nui_scissors_push_device(ctx, inner_rect);
+    NUI_AABB label_bounds = {
+        nui_fixed_floor(inner.x + (inner.w - text_w_fixed) / 2),
+        nui_fixed_floor(inner.y + (inner.h - text_h_fixed) / 2),
+        text_w,
+        text_h,
+    };
+    nui_push_command_text(ctx, label, (int)strlen(label), label_bounds,
+                          ctx->style.text);
     nui_scissors_pop(ctx);
 
-    return (ctx->active == id && ctx->input.mouse_released);
+    return clicked;
 }
 
-bool nui_next_command(NUI_Context *ctx, NUI_Command *out_cmd) {
-    // Iterate through sorted containers
-    while (ctx->iter_container_index < ctx->sorted_count) {
-        NUI_Container *c = ctx->sorted_containers[ctx->iter_container_index];
+void nui_image(NUI_Context *ctx, NUI_UserTexture texture, int w, int h,
+               NUI_UVRect uv) {
+    if (!ctx->current_container) {
+        ctx->limits.orphan_widgets++;
+        return;
+    }
+
+    NUI_FixedAABB area =
+        nui_layout_allocate(ctx, nui_scale(ctx, w), nui_scale(ctx, h));
+    nui_push_command_image(ctx, nui_fixed_snap(area), texture, uv);
+}
+
+void nui_container_invalidate(NUI_Context *ctx, const char *title) {
+    nui_container_invalidate_id(ctx, nui_hash(title, 0));
+}
+
+void nui_container_invalidate_id(NUI_Context *ctx, NUI_Id id) {
+    for (int i = 0; i < ctx->container_count; i++) {
+        if (ctx->container_list[i].id == id) {
+            ctx->container_list[i].cache_valid = false;
+            return;
+        }
+    }
+}
+
+// Measures the width of a word through the context's word cache. Words
+// longer than NUI_MAX_WORD_LENGTH are measured by their prefix.
+static int nui_measure_word(NUI_Context *ctx, const char *text, int length) {
+    length = MIN(length, NUI_MAX_WORD_LENGTH - 1);
+    if (!ctx->word_widths)
+        ctx->word_widths = calloc(NUI_WORD_CACHE_SIZE, sizeof(NUI_WordWidth));
+
+    NUI_Id hash = nui_hash_bytes(text, length, 2166136261u);
+    NUI_WordWidth *slot = NULL;
+    if (ctx->word_widths) {
+        slot = &ctx->word_widths[hash & (NUI_WORD_CACHE_SIZE - 1)];
+        if (slot->hash == hash && slot->length == length)
+            return slot->width;
+    }
+
+    char word[NUI_MAX_WORD_LENGTH];
+    memcpy(word, text, length);
+    word[length] = '\0';
+    int width, height;
+    nui_measure_user_text(ctx->resources, word, &width, &height);
+
+    // Replace whatever word was in the slot
+    if (slot)
+        *slot = (NUI_WordWidth){hash, length, width};
+    return width;
+}
+
+static void nui_text_layout_push_line(NUI_Context *ctx,
+                                      NUI_TextLayout *layout, int start,
+                                      int length) {
+    if (layout->line_count == layout->line_capacity) {
+        int capacity = layout->line_capacity ? layout->line_capacity * 2 : 64;
+        NUI_TextLine *lines =
+            realloc(layout->lines, capacity * sizeof(*layout->lines));
+        if (!lines) {
+            ctx->limits.allocation_failures++;
+            return;
+        }
+        layout->lines = lines;
+        layout->line_capacity = capacity;
+    }
+
+    layout->lines[layout->line_count++] = (NUI_TextLine){start, length};
+}
+
+// Greedily wraps text from `start` on, appending lines to the layout. Words
+// are only broken at spaces and newlines, a word wider than the layout gets
+// a line of its own.
+static void nui_text_layout_wrap(NUI_Context *ctx, NUI_TextLayout *layout,
+                                 const char *text, int start, int length) {
+    int space_w, line_h;
+    nui_resources_measure_text(ctx->resources, " ", &space_w, &line_h);
+    layout->line_height = line_h;
+
+    int pos = start;
+    int line_start = pos;
+    int line_end = pos;
+    int64_t line_w = 0;
+    while (pos < length) {
+        if (text[pos] == '\n') {
+            nui_text_layout_push_line(ctx, layout, line_start,
+                                      line_end - line_start);
+            pos++;
+            line_start = line_end = pos;
+            line_w = 0;
+            continue;
+        }
+        if (text[pos] == ' ') {
+            pos++;
+            continue;
+        }
+
+        int word_start = pos;
+        while (pos < length && text[pos] != ' ' && text[pos] != '\n')
+            pos++;
+
+        int word_w = nui_measure_word(ctx, &text[word_start], pos - word_start);
+
+        // Spaces before the first word of a line are kept as indentation
+        int64_t gap_w = (int64_t)(word_start - line_end) * space_w;
+        if (line_end == line_start ||
+            line_w + gap_w + word_w <= layout->width) {
+            line_w += gap_w + word_w;
+        } else {
+            nui_text_layout_push_line(ctx, layout, line_start,
+                                      line_end - line_start);
+            line_start = word_start;
+            line_w = word_w;
+        }
+        line_end = pos;
+    }
+
+    // A trailing newline does not start another line
+    if (line_start < length) {
+        nui_text_layout_push_line(ctx, layout, line_start,
+                                  line_end - line_start);
+    }
+}
+
+// Returns an unused layout to wrap new text into, or the stalest one. Grows
+// the layouts instead when every one of them was used this frame, so that
+// texts do not evict each other and get rewrapped on every frame.
+static NUI_TextLayout *nui_new_text_layout(NUI_Context *ctx) {
+    NUI_TextLayout *stalest = NULL;
+    for (int i = 0; i < ctx->text_layout_count; i++) {
+        if (!stalest || ctx->text_layouts[i].last_used < stalest->last_used)
+            stalest = &ctx->text_layouts[i];
+    }
+
+    if (ctx->text_layout_count == ctx->text_layout_capacity &&
+        (!stalest || stalest->last_used == ctx->frame_index)) {
+        int capacity = ctx->text_layout_capacity
+                           ? ctx->text_layout_capacity * 2
+                           : NUI_TEXT_LAYOUT_CACHE_SIZE;
+        NUI_TextLayout *layouts =
+            realloc(ctx->text_layouts, capacity * sizeof(*layouts));
+        if (!layouts) {
+            ctx->limits.allocation_failures++;
+            return stalest;
+        }
+        memset(&layouts[ctx->text_layout_count], 0,
+               (capacity - ctx->text_layout_count) * sizeof(*layouts));
+        ctx->text_layouts = layouts;
+        ctx->text_layout_capacity = capacity;
+    }
+
+    if (ctx->text_layout_count < ctx->text_layout_capacity)
+        return &ctx->text_layouts[ctx->text_layout_count++];
+    return stalest;
+}
+
+static const NUI_TextLayout *nui_get_text_layout(NUI_Context *ctx,
+                                                 const char *text,
+                                                 int width) {
+    static const NUI_TextLayout no_layout = {0};
+    int count = ctx->text_layout_count;
+    int cursor = count > 0 ? ctx->text_layout_cursor % count : 0;
+
+    // Find a layout of the same buffer, either holding this very text or
+    // the text it may have grown from, e.g. a log that got appended to
+    NUI_TextLayout *grown = NULL;
+    for (int n = 0; n < count; n++) {
+        NUI_TextLayout *layout = &ctx->text_layouts[(cursor + n) % count];
+        if (layout->text == text && layout->width == width) {
+            grown = layout;
+            break;
+        }
+    }
+
+    // Hash the text in the same pass that finds its length, checking on the
+    // way whether it still starts with the text that was wrapped before
+    NUI_Id hash = 2166136261u; // FNV offset basis
+    int length = 0;
+    if (grown) {
+        while (length < grown->length && text[length])
+            hash = nui_hash_byte(hash, (unsigned char)text[length++]);
+        if (length != grown->length || hash != grown->hash)
+            grown = NULL;
+    }
+    while (text[length])
+        hash = nui_hash_byte(hash, (unsigned char)text[length++]);
+
+    // Reuse the line breaks of the same text wrapped to the same width
+    NUI_TextLayout *layout = NULL;
+    if (grown && grown->length == length) {
+        layout = grown;
+    } else {
+        for (int n = 0; n < count; n++) {
+            NUI_TextLayout *other = &ctx->text_layouts[(cursor + n) % count];
+            if (other->hash == hash && other->width == width &&
+                other->length == length) {
+                layout = other;
+                break;
+            }
+        }
+    }
+    if (layout) {
+        layout->text = text;
+        layout->last_used = ctx->frame_index;
+        ctx->text_layout_cursor = (int)(layout - ctx->text_layouts) + 1;
+        return layout;
+    }
+
+    layout = grown;
+    int start = 0;
+    if (layout) {
+        // Only the last line can change when text is appended, rewrap from it
+        if (layout->line_count > 0)
+            start = layout->lines[--layout->line_count].start;
+    } else {
+        layout = nui_new_text_layout(ctx);
+        if (!layout)
+            return &no_layout;
+        layout->line_count = 0;
+        layout->width = width;
+    }
+
+    int failures = ctx->limits.allocation_failures;
+    nui_text_layout_wrap(ctx, layout, text, start, length);
+    layout->hash = hash;
+    layout->text = text;
+    layout->length = length;
+    layout->last_used = ctx->frame_index;
+    ctx->text_layout_cursor = (int)(layout - ctx->text_layouts) + 1;
+
+    // Wrap again next time rather than keep lines that failed to allocate
+    if (ctx->limits.allocation_failures != failures) {
+        layout->text = NULL;
+        layout->length = -1;
+    }
+    return layout;
+}
+
+// Emits the lines of a text layout from `first` on, with line `first` at y.
+// Only the lines within the current scissors are emitted.
+static void nui_push_text_lines(NUI_Context *ctx, const char *text,
+                                const NUI_TextLayout *layout, int first, int x,
+                                int y) {
+    int line_h = layout->line_height;
+    if (line_h <= 0)
+        return;
+
+    int top = ctx->current_scissors.y - y;
+    int bottom = ctx->current_scissors.y + ctx->current_scissors.h - y;
+    int begin = first + (top > 0 ? top / line_h : 0);
+    int end = first + (bottom > 0 ? (bottom + line_h - 1) / line_h : 0);
+    end = MIN(end, layout->line_count);
+
+    for (int i = begin; i < end; i++) {
+        const NUI_TextLine *line = &layout->lines[i];
+        NUI_AABB bounds = {x, y + (i - first) * line_h, NUI_UNBOUNDED, line_h};
+        nui_push_command_text(ctx, text + line->start, line->length, bounds,
+                              ctx->style.text);
+    }
+}
+
+// Width left for an item at the layout's cursor
+static NUI_Fixed nui_layout_available_width(const NUI_Layout *layout) {
+    if (layout->column_count > 0)
+        return layout->columns[layout->column_index];
+    return layout->width - (layout->cursor_x - layout->start_x);
+}
+
+void nui_text(NUI_Context *ctx, const char *text) {
+    if (!ctx->current_container) {
+        ctx->limits.orphan_widgets++;
+        return;
+    }
+
+    NUI_Fixed width = nui_layout_available_width(&ctx->layout);
+    const NUI_TextLayout *layout =
+        nui_get_text_layout(ctx, text, nui_fixed_floor(width));
+
+    NUI_Fixed height = nui_fixed_clamp((int64_t)layout->line_count *
+                                       layout->line_height * NUI_FIXED_ONE);
+    NUI_AABB area = nui_fixed_snap(nui_layout_allocate(ctx, width, height));
+    nui_push_text_lines(ctx, text, layout, 0, area.x, area.y);
+}
+
+void nui_text_area(NUI_Context *ctx, const char *text, int height,
+                   int *scroll) {
+    if (!ctx->current_container) {
+        ctx->limits.orphan_widgets++;
+        return;
+    }
+
+    const NUI_StyleMetrics *metrics = &ctx->metrics;
+    NUI_Fixed width = nui_layout_available_width(&ctx->layout);
+    NUI_FixedAABB area_fixed =
+        nui_layout_allocate(ctx, width, nui_scale(ctx, height));
+    NUI_AABB area = nui_fixed_snap(area_fixed);
+    NUI_AABB inner_rect = nui_border_inset(ctx, area);
+    NUI_FixedAABB inner = nui_fixed_aabb(inner_rect);
+    NUI_FixedAABB content = {inner.x + metrics->padding_x,
+                             inner.y + metrics->padding_y,
+                             inner.w - 2 * metrics->padding_x,
+                             inner.h - 2 * metrics->padding_y};
+    NUI_AABB content_rect = nui_fixed_snap(content);
+
+    const NUI_TextLayout *layout =
+        nui_get_text_layout(ctx, text, content_rect.w);
+
+    // Clamp the scroll position to the lines that fit
+    int visible_lines =
+        layout->line_height > 0 ? content_rect.h / layout->line_height : 0;
+    int max_scroll = MAX(layout->line_count - visible_lines, 0);
+    int first = scroll ? MIN(MAX(*scroll, 0), max_scroll) : max_scroll;
+    if (scroll)
+        *scroll = first;
+
+    nui_push_command_rect(ctx, area, ctx->style.border);
+    nui_push_command_rect(ctx, inner_rect, ctx->style.text_area_bg);
+    nui_scissors_push_device(ctx, content_rect);
+    nui_push_text_lines(ctx, text, layout, first, content_rect.x,
+                        content_rect.y);
+    nui_scissors_pop(ctx);
+}
+
+// Returns the next command to drain without advancing the iterator
+static NUI_Command *nui_peek_command(NUI_Context *ctx) {
+    // Iterate through containers in z-order, skipping the ones that were not
+    // drawn this frame
+    while (ctx->iter_container) {
+        NUI_Container *c = ctx->iter_container;
 
         // Retrieve next command from this container
         if (ctx->iter_cmd_offset < c->command_count) {
             // Get actual command index in global buffer
             int cmd_index = c->command_start_index + ctx->iter_cmd_offset;
-            *out_cmd = ctx->commands[cmd_index];
-
-            ctx->iter_cmd_offset++;
-            return true;
+            return &ctx->commands[cmd_index];
         }
 
         // Finished this container, move to next
-        ctx->iter_container_index++;
+        ctx->iter_container = c->z_above;
         ctx->iter_cmd_offset = 0;
     }
 
-    return false;
+    return NULL;
+}
+
+// Copies out the peeked command, moving the content of a dirty cached
+// container into the local space of its target
+static void nui_drain_command(NUI_Context *ctx, const NUI_Command *cmd,
+                              NUI_Command *out_cmd) {
+    NUI_Container *c = ctx->iter_container;
+    *out_cmd = *cmd;
+    if (c->cache_dirty && ctx->iter_cmd_offset > 0) {
+        nui_translate_command(out_cmd, -c->area.x, -c->area.y);
+    }
+    ctx->iter_cmd_offset++;
+}
+
+bool nui_next_command(NUI_Context *ctx, NUI_Command *out_cmd) {
+    NUI_Command *cmd = nui_peek_command(ctx);
+    if (!cmd)
+        return false;
+
+    nui_drain_command(ctx, cmd, out_cmd);
+    return true;
+}
+
+NUI_Id nui_command_stream_hash(NUI_Context *ctx, int *out_count) {
+    NUI_Container *iter_container = ctx->iter_container;
+    int iter_cmd_offset = ctx->iter_cmd_offset;
+
+    NUI_Id hash = 2166136261u;
+    int count = 0;
+    NUI_Command cmd;
+    while (nui_next_command(ctx, &cmd)) {
+        // Texture pointers differ between runs, unlike within a session
+        // where the cached containers' hash needs them
+        if (cmd.type == NUI_CMD_IMAGE)
+            cmd.image.texture = NULL;
+        hash = nui_hash_command(&cmd, 0, 0, hash);
+        count++;
+    }
+
+    // Rewind so the stream can still be drained
+    ctx->iter_container = iter_container;
+    ctx->iter_cmd_offset = iter_cmd_offset;
+
+    if (out_count)
+        *out_count = count;
+    return hash;
+}
+
+int nui_next_image_batch(NUI_Context *ctx, NUI_UserTexture texture,
+                         NUI_CommandImage *out_images, int max_count) {
+    int count = 0;
+    while (count < max_count) {
+        NUI_Command *cmd = nui_peek_command(ctx);
+        if (!cmd || cmd->type != NUI_CMD_IMAGE ||
+            cmd->image.texture != texture)
+            break;
+
+        NUI_Command out_cmd;
+        nui_drain_command(ctx, cmd, &out_cmd);
+        out_images[count++] = out_cmd.image;
+    }
+
+    return count;
 }
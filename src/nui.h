@@ -6,24 +6,73 @@
 
 #define NUI_MAX_COMMANDS (1024)
 #define NUI_LAYOUT_STACK_SIZE (32)
+#define NUI_LAYOUT_MAX_COLUMNS (16)
 #define NUI_SCISSORS_STACK_SIZE (32)
 #define NUI_CONTAINER_LIST_SIZE (32)
+#define NUI_TEXT_CACHE_SIZE (1024)
+#define NUI_TEXT_CACHE_ARENA_SIZE (64 * 1024)
+// Wrapped text layouts a context starts with, more are added when a frame
+// draws more texts
+#define NUI_TEXT_LAYOUT_CACHE_SIZE (8)
+#define NUI_WORD_CACHE_SIZE (1024)
+// Longest word measured as a whole when wrapping text, longer words are
+// measured by this prefix
+#define NUI_MAX_WORD_LENGTH (256)
+// Coordinates, sizes and measured text are clamped to this many pixels
+// either way, which keeps the 24.8 fixed-point layout math from overflowing
+#define NUI_COORD_MAX (1 << 18)
+// Largest weight of a fill column, larger weights are clamped
+#define NUI_MAX_FILL_WEIGHT (1 << 16)
 
 typedef uint32_t NUI_Id;
 
+// 24.8 fixed-point value, used for layout and scaled style metrics
+typedef int32_t NUI_Fixed;
+
 typedef struct {
     int x, y, w, h;
 } NUI_AABB;
 
+// Rects stored as structure of arrays, so that the batch kernels can process
+// several of them at once
+typedef struct {
+    int *x, *y, *w, *h;
+} NUI_AABBArray;
+
 typedef struct {
     unsigned char r, g, b, a;
 } NUI_Color;
 
-// A container has a retained area and z-index
+// Normalized texture coordinates of an image within its texture
 typedef struct {
+    float u0, v0, u1, v1;
+} NUI_UVRect;
+
+// User provided texture type, e.g. an atlas shared by many images
+typedef void *NUI_UserTexture;
+
+typedef enum {
+    NUI_WINDOW_NONE = 0,
+    // Let the backend cache the rendered window in an offscreen target, see
+    // NUI_CMD_CACHED_CONTAINER
+    NUI_WINDOW_CACHED = 1 << 0,
+} NUI_WindowFlags;
+
+// A container has a retained area and a place in the z-order list
+typedef struct NUI_Container {
     NUI_Id id;
     NUI_AABB area;
-    int z_index;
+    int flags;
+
+    // Position independent hash of the content in the backend's cached target
+    NUI_Id cache_hash;
+    bool cache_valid;
+    // Whether this frame's command slice redraws the cached target
+    bool cache_dirty;
+
+    // Neighbours in the z-ordered container list
+    struct NUI_Container *z_above;
+    struct NUI_Container *z_below;
 
     // Command slice within the global command buffer
     int command_start_index;
@@ -34,6 +83,8 @@ typedef enum {
     NUI_CMD_RECT,
     NUI_CMD_TEXT,
     NUI_CMD_SCISSORS,
+    NUI_CMD_IMAGE,
+    NUI_CMD_CACHED_CONTAINER,
 } NUI_CommandType;
 
 typedef struct {
@@ -41,22 +92,45 @@ typedef struct {
     NUI_Color color;
 } NUI_CommandRect;
 
+// The text is a slice of `length` bytes and is not NUL-terminated in general
 typedef struct {
     const char *text;
     int x, y;
     NUI_Color color;
+    int length;
 } NUI_CommandText;
 
 typedef struct {
     NUI_AABB area;
 } NUI_CommandScissors;
 
+typedef struct {
+    NUI_AABB rect;
+    NUI_UserTexture texture;
+    NUI_UVRect uv;
+} NUI_CommandImage;
+
+// Emitted for containers with NUI_WINDOW_CACHED in place of their content.
+// When not dirty, the backend only blits its cached target for `id` at
+// `area`. When dirty, the next `command_count` commands redraw that target in
+// container-local coordinates before it is blitted. Cached windows are
+// clipped to their own area only, and scissors set while redrawing only apply
+// to the target.
+typedef struct {
+    NUI_Id id;
+    NUI_AABB area;
+    bool dirty;
+    int command_count;
+} NUI_CommandCachedContainer;
+
 typedef struct {
     NUI_CommandType type;
     union {
         NUI_CommandRect rect;
         NUI_CommandText text;
         NUI_CommandScissors scissors;
+        NUI_CommandImage image;
+        NUI_CommandCachedContainer cached;
     };
 } NUI_Command;
 
@@ -77,14 +151,42 @@ typedef enum {
     NUI_LAYOUT_HORIZONTAL,
 } NUI_LayoutMode;
 
+typedef enum {
+    // Width in logical pixels
+    NUI_SIZE_PIXELS,
+    // Percentage of the row's width left after margins, from 0 to 100
+    NUI_SIZE_PERCENT,
+    // Weighted share of the width left after pixel and percent columns, with
+    // weights from 0 to NUI_MAX_FILL_WEIGHT
+    NUI_SIZE_FILL,
+} NUI_SizeKind;
+
 typedef struct {
-    int cursor_x, cursor_y;
-    int start_x, start_y;
-    int size_x, size_y;
-    int row_height;
-    int width;
-    int margin;
+    NUI_SizeKind kind;
+    int value;
+} NUI_Size;
+
+#define NUI_PX(px) ((NUI_Size){NUI_SIZE_PIXELS, (px)})
+#define NUI_PERCENT(percent) ((NUI_Size){NUI_SIZE_PERCENT, (percent)})
+#define NUI_FILL(weight) ((NUI_Size){NUI_SIZE_FILL, (weight)})
+
+// Layout state is kept in device pixels as 24.8 fixed-point, so scaled
+// metrics accumulate without rounding errors until a rect is emitted
+typedef struct {
+    NUI_Fixed cursor_x, cursor_y;
+    NUI_Fixed start_x, start_y;
+    NUI_Fixed size_x, size_y;
+    NUI_Fixed row_height;
+    NUI_Fixed width;
+    NUI_Fixed margin;
     NUI_LayoutMode mode;
+
+    // Resolved column widths of the current row spec, see nui_layout_row
+    NUI_Fixed columns[NUI_LAYOUT_MAX_COLUMNS];
+    int column_count;
+    int column_index;
+    // Fixed row height, or 0 to fit the tallest item
+    NUI_Fixed column_height;
 } NUI_Layout;
 
 typedef struct {
@@ -103,8 +205,22 @@ typedef struct {
     int padding_x, padding_y;
     int margin;
 
+    // Height reserved for the window title text
+    int title_text_height;
+
+    NUI_Color text_area_bg;
+
 } NUI_Style;
 
+// Style metrics pre-scaled to device pixels, as 24.8 fixed-point. The border
+// is rounded to whole device pixels.
+typedef struct {
+    NUI_Fixed border_radius;
+    NUI_Fixed padding_x, padding_y;
+    NUI_Fixed margin;
+    NUI_Fixed title_text_height;
+} NUI_StyleMetrics;
+
 extern const NUI_Style nui_default_style;
 
 // User provided font type
@@ -113,38 +229,107 @@ typedef void (*NUI_MeasureTextCallback)(NUI_UserFont font, const char *text,
                                         int *out_width, int *out_height);
 
 typedef struct {
-    // User provided
-    NUI_MeasureTextCallback measure_text;
-    NUI_UserFont font;
+    int start;
+    int length;
+} NUI_TextLine;
+
+// Cached line breaks of a text wrapped to a width. Keyed by the text's hash
+// and the wrap width, the font being fixed by the context's resources.
+typedef struct {
+    NUI_Id hash;
+    int width;
+    // Text the breaks were computed for, used to only wrap what was appended
+    // when the same buffer grows
+    const char *text;
+    int length;
+
+    int line_height;
+    NUI_TextLine *lines;
+    int line_count;
+    int line_capacity;
+
+    // Frame the layout was last used in, for evicting the stalest one
+    unsigned int last_used;
+} NUI_TextLayout;
+
+// Measured width of a word of wrapped text, keyed by its hash and length.
+// A length of 0 marks an empty slot.
+typedef struct {
+    NUI_Id hash;
+    int length;
+    int width;
+} NUI_WordWidth;
+
+// Number of times a fixed limit was hit during the current frame. Hitting a
+// limit never fails, the affected work is dropped instead:
+// - commands past the command buffer are not emitted
+// - pushes past a full stack are ignored along with their matching pops, so
+//   the content keeps the enclosing layout or scissors
+// - pops of an empty stack are ignored
+// - windows past the container list are not drawn
+// - row spec columns past NUI_LAYOUT_MAX_COLUMNS are ignored
+// - widgets outside of a window are not drawn
+// - text whose lines fail to allocate shows the lines allocated so far
+// - a context that failed to allocate its resources or command buffer draws
+//   nothing, counting an allocation failure every frame
+typedef struct {
+    int dropped_commands;
+    int layout_overflows;
+    int layout_underflows;
+    int scissors_overflows;
+    int scissors_underflows;
+    int container_overflows;
+    int column_overflows;
+    int orphan_widgets;
+    int allocation_failures;
+} NUI_LimitCounters;
+
+// Resources that can be shared between contexts, possibly on different
+// threads. Holds the font along with a cache of measured text metrics, and
+// the scale the font measures at. The measure_text callback is called without
+// any lock held, so it must be thread-safe when contexts on several threads
+// share the resources.
+typedef struct NUI_Resources NUI_Resources;
+
+typedef struct {
+    // Shared resources, owned by the context if created through nui_init
+    NUI_Resources *resources;
+    bool owns_resources;
 
     // State
     NUI_InputState input;
     NUI_Style style;
+    // Device pixels per logical pixel, as 24.8 fixed-point
+    NUI_Fixed scale;
+    NUI_StyleMetrics metrics;
 
     // Layout
     NUI_Layout layout;
     NUI_Layout layout_stack[NUI_LAYOUT_STACK_SIZE];
     int layout_stack_top;
+    // Pushes ignored since the stack was full, still waiting for their pop
+    int layout_overflow_depth;
 
     // Scissors
     NUI_AABB scissors_stack[NUI_SCISSORS_STACK_SIZE];
     NUI_AABB current_scissors;
     int scissors_stack_top;
+    int scissors_overflow_depth;
 
     // Container list
     NUI_Container container_list[NUI_CONTAINER_LIST_SIZE];
     int container_count;
+    // Z-ordered container list, bottom-most to top-most
+    NUI_Container *z_bottom;
+    NUI_Container *z_top;
     // Topmost hovered container
     NUI_Id hover_container_id;
-    int last_z_index;
 
     // The active container currently being drawn to
     NUI_Container *current_container;
     // Command iterator State
-    NUI_Container *sorted_containers[NUI_CONTAINER_LIST_SIZE];
-    int sorted_count;
-    // The index of the current container being iterated when draining commands
-    int iter_container_index;
+    // The current container being iterated when draining commands
+    NUI_Container *iter_container;
     // The offset of the current command within the current container being
     // iterated
     int iter_cmd_offset;
@@ -154,15 +339,85 @@ typedef struct {
     NUI_Id active;
     NUI_Id last_active;
 
-    // Command Buffer
-    NUI_Command commands[NUI_MAX_COMMANDS];
+    // Wrapped text layouts, starting at NUI_TEXT_LAYOUT_CACHE_SIZE and grown
+    // whenever a frame wraps more texts than they hold. The array and the
+    // line arrays are heap allocated.
+    NUI_TextLayout *text_layouts;
+    int text_layout_count;
+    int text_layout_capacity;
+    // Where the next lookup starts, after the layout last returned, as texts
+    // are usually drawn in the same order every frame
+    int text_layout_cursor;
+    // Direct-mapped cache of the words measured while wrapping, kept out of
+    // the resources' cache so that words do not crowd out the labels there.
+    // Heap allocated on first use.
+    NUI_WordWidth *word_widths;
+    unsigned int frame_index;
+
+    // Command Buffer, heap allocated by nui_init
+    NUI_Command *commands;
+    int command_capacity;
     int command_count;
+
+    // Bounds and scissors of the primitives drawn since the last clipping
+    // pass, clipped in one batch when a window ends. Heap allocated along
+    // with the command buffer.
+    NUI_AABBArray clip_bounds;
+    NUI_AABBArray clip_scissors;
+    int *clip_visible;
+    // Index of each primitive's command
+    int *clip_commands;
+    int clip_count;
+    // First command not yet seen by a clipping pass
+    int clip_start;
+
+    NUI_LimitCounters limits;
 } NUI_Context;
 
+// Batch AABB kernels, using SSE2, NEON or WASM SIMD when available unless
+// NUI_NO_SIMD is defined. Coordinates and sums of a coordinate and a size must
+// fit in an int.
+// Clips each rect against the scissors at the same index. Writes the
+// intersection to `out`, which may alias `rects`, and whether it is non-empty
+// to `visible`. Fully clipped rects are written as {0, 0, 0, 0}.
+void nui_aabb_clip_batch(NUI_AABBArray rects, NUI_AABBArray scissors,
+                         NUI_AABBArray out, int *visible, int count);
+// Returns the highest index of a rect containing the point, or -1
+int nui_aabb_hit_test_batch(NUI_AABBArray rects, int count, int x, int y);
+// Scalar references, which the SIMD kernels match bit for bit
+void nui_aabb_clip_batch_scalar(NUI_AABBArray rects, NUI_AABBArray scissors,
+                                NUI_AABBArray out, int *visible, int count);
+int nui_aabb_hit_test_batch_scalar(NUI_AABBArray rects, int count, int x,
+                                   int y);
+
+// Resources
+// Returns NULL when out of memory
+NUI_Resources *nui_resources_create(NUI_MeasureTextCallback measure_text,
+                                    NUI_UserFont font);
+void nui_resources_destroy(NUI_Resources *resources);
+// Measures text through the resources' cache, safe to call from any thread
+void nui_resources_measure_text(NUI_Resources *resources, const char *text,
+                                int *out_width, int *out_height);
+
 // Context
 void nui_init(NUI_Context *ctx, NUI_MeasureTextCallback measure_text,
               NUI_UserFont font);
+// Initializes a context that uses resources shared with other contexts. The
+// resources must outlive the context. NULL resources, e.g. from a failed
+// nui_resources_create, leave the context drawing nothing.
+void nui_init_shared(NUI_Context *ctx, NUI_Resources *resources);
+void nui_destroy(NUI_Context *ctx);
+// Style metrics are in logical pixels and get scaled to device pixels
 void nui_set_style(NUI_Context *ctx, NUI_Style style);
+// Sets the device pixels per logical pixel, e.g. 2 on HiDPI displays. Areas
+// and sizes passed to nanoUi are in logical pixels, while mouse input,
+// measured text and all emitted commands are in device pixels.
+// The scale belongs to the resources, as their font measures at a single
+// size: it clears the measured text, and other contexts sharing the resources
+// follow at their next nui_frame_begin. Resize the font before calling this,
+// between frames, and use separate resources per scale, e.g. per monitor.
+// The scale is clamped between 1/256 and 64.
+void nui_set_scale(NUI_Context *ctx, float scale);
 
 // Input
 void nui_input_mouse_move(NUI_Context *ctx, int x, int y);
@@ -175,11 +430,42 @@ void nui_scissors_push(NUI_Context *ctx, NUI_AABB area);
 void nui_scissors_pop(NUI_Context *ctx);
 void nui_layout_push(NUI_Context *ctx, NUI_AABB area, NUI_LayoutMode mode);
 void nui_layout_pop(NUI_Context *ctx);
-bool nui_window_begin(NUI_Context *ctx, const char *title, NUI_AABB area);
+// Lays out the following items in rows of the given columns, repeating for
+// as many rows as needed. Widths are resolved once here, items then take the
+// width of their column. A height of 0 fits each row to its tallest item.
+// Passing no columns returns to the layout's own mode.
+void nui_layout_row(NUI_Context *ctx, int count, const NUI_Size *columns,
+                    int height);
+// The area is only used to place the window when it first appears
+bool nui_window_begin(NUI_Context *ctx, const char *title, NUI_AABB area,
+                      int flags);
 void nui_window_end(NUI_Context *ctx);
 bool nui_button(NUI_Context *ctx, const char *label);
+// Multi-line text wrapped to the available width
+void nui_text(NUI_Context *ctx, const char *text);
+// Read-only scrolled text box of the given logical height, e.g. for logs.
+// `scroll` is the first visible line and is clamped in place; pass NULL to
+// follow the end of the text.
+void nui_text_area(NUI_Context *ctx, const char *text, int height,
+                   int *scroll);
+void nui_image(NUI_Context *ctx, NUI_UserTexture texture, int w, int h,
+               NUI_UVRect uv);
 
 // Commands
+// Forces the next frame to redraw the cached window with the given title,
+// e.g. after the backend lost its offscreen target
+void nui_container_invalidate(NUI_Context *ctx, const char *title);
+// Same as nui_container_invalidate, by the id of the cached container
+// command, e.g. when the backend evicts that container's target
+void nui_container_invalidate_id(NUI_Context *ctx, NUI_Id id);
 bool nui_next_command(NUI_Context *ctx, NUI_Command *out_cmd);
+// Hashes the remaining command stream without draining it, e.g. to compare
+// the output of two runs. Image textures are left out, as their pointers
+// differ between runs.
+NUI_Id nui_command_stream_hash(NUI_Context *ctx, int *out_count);
+// Drains up to max_count image commands that directly follow in the command
+// stream and share the given texture, so they can be drawn in one batch
+int nui_next_image_batch(NUI_Context *ctx, NUI_UserTexture texture,
+                         NUI_CommandImage *out_images, int max_count);
 
 #endif // NUI_H
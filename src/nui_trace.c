@@ -0,0 +1,191 @@
+#include "nui_trace.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool nui_trace_record_begin(NUI_TraceRecorder *recorder, const char *path,
+                            NUI_MeasureTextCallback measure_text,
+                            NUI_UserFont font) {
+    assert(measure_text && "measure_text must not be NULL");
+
+    recorder->file = fopen(path, "w");
+    recorder->measure_text = measure_text;
+    recorder->font = font;
+    recorder->frame_count = 0;
+    return recorder->file != NULL;
+}
+
+void nui_trace_record_end(NUI_TraceRecorder *recorder) {
+    if (recorder->file) {
+        fprintf(recorder->file, "E %d\n", recorder->frame_count);
+        fclose(recorder->file);
+        recorder->file = NULL;
+    }
+}
+
+void nui_trace_record_measure_text(NUI_UserFont font, const char *text,
+                                   int *out_width, int *out_height) {
+    NUI_TraceRecorder *recorder = font;
+    recorder->measure_text(recorder->font, text, out_width, out_height);
+
+    if (recorder->file) {
+        fprintf(recorder->file, "T %d %d %zu %s\n", *out_width, *out_height,
+                strlen(text), text);
+    }
+}
+
+void nui_trace_record_mouse_move(NUI_TraceRecorder *recorder,
+                                 NUI_Context *ctx, int x, int y) {
+    nui_input_mouse_move(ctx, x, y);
+    if (recorder->file) {
+        fprintf(recorder->file, "M %d %d\n", x, y);
+    }
+}
+
+void nui_trace_record_mouse_button(NUI_TraceRecorder *recorder,
+                                   NUI_Context *ctx, bool down) {
+    nui_input_mouse_button(ctx, down);
+    if (recorder->file) {
+        fprintf(recorder->file, "B %d\n", down);
+    }
+}
+
+void nui_trace_record_frame(NUI_TraceRecorder *recorder, NUI_Context *ctx) {
+    if (!recorder->file)
+        return;
+
+    int count;
+    NUI_Id hash = nui_command_stream_hash(ctx, &count);
+    fprintf(recorder->file, "F %d %u\n", count, (unsigned int)hash);
+    recorder->frame_count++;
+}
+
+bool nui_trace_play_begin(NUI_TracePlayer *player, const char *path) {
+    memset(player, 0, sizeof(*player));
+    player->file = fopen(path, "r");
+    return player->file != NULL;
+}
+
+void nui_trace_play_end(NUI_TracePlayer *player) {
+    if (player->file) {
+        fclose(player->file);
+    }
+    for (int i = 0; i < player->text_count; i++) {
+        free(player->texts[i].text);
+    }
+    free(player->texts);
+    memset(player, 0, sizeof(*player));
+}
+
+static NUI_TraceText *nui_trace_find_text(NUI_TracePlayer *player,
+                                          const char *text) {
+    for (int i = 0; i < player->text_count; i++) {
+        if (strcmp(player->texts[i].text, text) == 0) {
+            return &player->texts[i];
+        }
+    }
+    return NULL;
+}
+
+void nui_trace_play_measure_text(NUI_UserFont font, const char *text,
+                                 int *out_width, int *out_height) {
+    NUI_TracePlayer *player = font;
+    NUI_TraceText *entry = nui_trace_find_text(player, text);
+
+    // Text that was never measured while recording can not match anyway
+    *out_width = entry ? entry->width : 0;
+    *out_height = entry ? entry->height : 0;
+}
+
+// Reads the text of a "T" record and stores its metrics
+static bool nui_trace_read_text(NUI_TracePlayer *player) {
+    int width, height;
+    size_t length;
+    if (fscanf(player->file, "%d %d %zu", &width, &height, &length) != 3 ||
+        fgetc(player->file) != ' ') {
+        return false;
+    }
+
+    char *text = malloc(length + 1);
+    if (!text || fread(text, 1, length, player->file) != length) {
+        free(text);
+        return false;
+    }
+    text[length] = '\0';
+
+    NUI_TraceText *entry = nui_trace_find_text(player, text);
+    if (entry) {
+        entry->width = width;
+        entry->height = height;
+        free(text);
+        return true;
+    }
+
+    if (player->text_count == player->text_capacity) {
+        int capacity = player->text_capacity ? player->text_capacity * 2 : 64;
+        NUI_TraceText *texts =
+            realloc(player->texts, capacity * sizeof(*player->texts));
+        if (!texts) {
+            free(text);
+            return false;
+        }
+        player->texts = texts;
+        player->text_capacity = capacity;
+    }
+
+    player->texts[player->text_count++] = (NUI_TraceText){width, height, text};
+    return true;
+}
+
+NUI_TraceStatus nui_trace_play_frame(NUI_TracePlayer *player,
+                                     NUI_Context *ctx,
+                                     NUI_TraceFrame *out_expected) {
+    if (!player->file)
+        return NUI_TRACE_ERROR;
+
+    char record;
+    while (fscanf(player->file, " %c", &record) == 1) {
+        switch (record) {
+        case 'M': {
+            int x, y;
+            if (fscanf(player->file, "%d %d", &x, &y) != 2)
+                return NUI_TRACE_ERROR;
+            nui_input_mouse_move(ctx, x, y);
+        } break;
+        case 'B': {
+            int down;
+            if (fscanf(player->file, "%d", &down) != 1)
+                return NUI_TRACE_ERROR;
+            nui_input_mouse_button(ctx, down != 0);
+        } break;
+        case 'T':
+            if (!nui_trace_read_text(player))
+                return NUI_TRACE_ERROR;
+            break;
+        case 'F': {
+            unsigned int hash;
+            if (fscanf(player->file, "%d %u", &out_expected->command_count,
+                       &hash) != 2)
+                return NUI_TRACE_ERROR;
+            out_expected->command_hash = hash;
+            player->frame_count++;
+            return NUI_TRACE_FRAME;
+        }
+        case 'E': {
+            // Only a complete trace ends with the number of frames played
+            int frame_count;
+            if (fscanf(player->file, "%d", &frame_count) != 1 ||
+                frame_count != player->frame_count)
+                return NUI_TRACE_ERROR;
+            return NUI_TRACE_END;
+        }
+        default:
+            return NUI_TRACE_ERROR;
+        }
+    }
+
+    // Reaching the end of the file without an E record means the trace was
+    // cut short
+    return NUI_TRACE_ERROR;
+}
@@ -0,0 +1,92 @@
+#ifndef NUI_TRACE_H
+#define NUI_TRACE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "nui.h"
+
+// Traces capture a session's per-frame input together with the measured text
+// metrics and a hash of the resulting command stream, so that the session can
+// be replayed headlessly and checked for identical output.
+//
+// A trace is a text file with one record per line:
+//   M <x> <y>                  mouse move
+//   B <down>                   mouse button
+//   T <w> <h> <length> <text>  text metrics measured during the frame
+//   F <count> <hash>           end of frame and its expected command stream
+//   E <frames>                 end of the trace and its number of frames
+//
+// A trace that ends without its E record was cut short and fails to play.
+
+typedef struct {
+    FILE *file;
+
+    // The measure callback being recorded
+    NUI_MeasureTextCallback measure_text;
+    NUI_UserFont font;
+
+    int frame_count;
+} NUI_TraceRecorder;
+
+typedef struct {
+    int width, height;
+    char *text;
+} NUI_TraceText;
+
+typedef struct {
+    FILE *file;
+
+    // Text metrics read from the trace so far
+    NUI_TraceText *texts;
+    int text_count;
+    int text_capacity;
+
+    int frame_count;
+} NUI_TracePlayer;
+
+typedef struct {
+    int command_count;
+    NUI_Id command_hash;
+} NUI_TraceFrame;
+
+typedef enum {
+    // A frame was fed into the context
+    NUI_TRACE_FRAME,
+    // The trace ended cleanly
+    NUI_TRACE_END,
+    // The trace is malformed, truncated or could not be read
+    NUI_TRACE_ERROR,
+} NUI_TraceStatus;
+
+// Recording
+// The context must be initialized with nui_trace_record_measure_text and the
+// recorder as its font, so that text metrics end up in the trace
+bool nui_trace_record_begin(NUI_TraceRecorder *recorder, const char *path,
+                            NUI_MeasureTextCallback measure_text,
+                            NUI_UserFont font);
+void nui_trace_record_end(NUI_TraceRecorder *recorder);
+void nui_trace_record_measure_text(NUI_UserFont font, const char *text,
+                                   int *out_width, int *out_height);
+// Forward the input to the context and record it
+void nui_trace_record_mouse_move(NUI_TraceRecorder *recorder,
+                                 NUI_Context *ctx, int x, int y);
+void nui_trace_record_mouse_button(NUI_TraceRecorder *recorder,
+                                   NUI_Context *ctx, bool down);
+// Records the end of a frame, call after nui_frame_end and before draining
+void nui_trace_record_frame(NUI_TraceRecorder *recorder, NUI_Context *ctx);
+
+// Replaying
+// The context must be initialized with nui_trace_play_measure_text and the
+// player as its font, so that text measures as it did when recorded
+bool nui_trace_play_begin(NUI_TracePlayer *player, const char *path);
+void nui_trace_play_end(NUI_TracePlayer *player);
+void nui_trace_play_measure_text(NUI_UserFont font, const char *text,
+                                 int *out_width, int *out_height);
+// Feeds the next frame's input into the context and returns the command
+// stream it is expected to produce in out_expected
+NUI_TraceStatus nui_trace_play_frame(NUI_TracePlayer *player,
+                                     NUI_Context *ctx,
+                                     NUI_TraceFrame *out_expected);
+
+#endif // NUI_TRACE_H
@@ -0,0 +1,93 @@
+#ifndef NUI_MODEL_ARM_NEON_H
+#define NUI_MODEL_ARM_NEON_H
+
+// Plain C model of the NEON intrinsics nanoUi uses, following the Arm
+// intrinsics reference lane by lane. Lets `make test-simd-models` run the
+// NEON kernels on hosts without an Arm toolchain; `make test-neon` runs
+// them on the real instructions.
+
+#include <stdint.h>
+
+typedef struct {
+    int32_t lanes[4];
+} int32x4_t;
+
+typedef struct {
+    uint32_t lanes[4];
+} uint32x4_t;
+
+#define NUI_MODEL_LANES(i) for (int i = 0; i < 4; i++)
+
+static inline int32x4_t vld1q_s32(const int32_t *p) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = p[i];
+    return r;
+}
+static inline void vst1q_s32(int32_t *p, int32x4_t v) {
+    NUI_MODEL_LANES(i) p[i] = v.lanes[i];
+}
+static inline int32x4_t vdupq_n_s32(int32_t v) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = v;
+    return r;
+}
+// Lanes wrap around like the instructions do
+static inline int32x4_t vaddq_s32(int32x4_t a, int32x4_t b) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = (int32_t)((uint32_t)a.lanes[i] + (uint32_t)b.lanes[i]);
+    return r;
+}
+static inline int32x4_t vsubq_s32(int32x4_t a, int32x4_t b) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = (int32_t)((uint32_t)a.lanes[i] - (uint32_t)b.lanes[i]);
+    return r;
+}
+static inline uint32x4_t vcgtq_s32(int32x4_t a, int32x4_t b) {
+    uint32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = a.lanes[i] > b.lanes[i] ? 0xFFFFFFFFu : 0;
+    return r;
+}
+static inline int32x4_t vandq_s32(int32x4_t a, int32x4_t b) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = a.lanes[i] & b.lanes[i];
+    return r;
+}
+// a & ~b
+static inline int32x4_t vbicq_s32(int32x4_t a, int32x4_t b) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = a.lanes[i] & ~b.lanes[i];
+    return r;
+}
+static inline int32x4_t vminq_s32(int32x4_t a, int32x4_t b) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = a.lanes[i] < b.lanes[i] ? a.lanes[i] : b.lanes[i];
+    return r;
+}
+static inline int32x4_t vmaxq_s32(int32x4_t a, int32x4_t b) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = a.lanes[i] > b.lanes[i] ? a.lanes[i] : b.lanes[i];
+    return r;
+}
+static inline uint32x4_t vshrq_n_u32(uint32x4_t a, int n) {
+    uint32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = a.lanes[i] >> n;
+    return r;
+}
+static inline int32x4_t vreinterpretq_s32_u32(uint32x4_t a) {
+    int32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = (int32_t)a.lanes[i];
+    return r;
+}
+static inline uint32x4_t vreinterpretq_u32_s32(int32x4_t a) {
+    uint32x4_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = (uint32_t)a.lanes[i];
+    return r;
+}
+
+#undef NUI_MODEL_LANES
+
+#endif // NUI_MODEL_ARM_NEON_H
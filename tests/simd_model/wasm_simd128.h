@@ -0,0 +1,88 @@
+#ifndef NUI_MODEL_WASM_SIMD128_H
+#define NUI_MODEL_WASM_SIMD128_H
+
+// Plain C model of the WebAssembly SIMD intrinsics nanoUi uses, following
+// the WebAssembly SIMD specification lane by lane. Lets
+// `make test-simd-models` run the WASM kernels natively; `make test-wasm`
+// runs them on a real engine.
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+    int32_t lanes[4];
+} v128_t;
+
+#define NUI_MODEL_LANES(i) for (int i = 0; i < 4; i++)
+
+static inline v128_t wasm_v128_load(const void *p) {
+    v128_t r;
+    memcpy(r.lanes, p, sizeof(r.lanes));
+    return r;
+}
+static inline void wasm_v128_store(void *p, v128_t v) {
+    memcpy(p, v.lanes, sizeof(v.lanes));
+}
+static inline v128_t wasm_i32x4_splat(int32_t v) {
+    v128_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = v;
+    return r;
+}
+// Lanes wrap around like the instructions do
+static inline v128_t wasm_i32x4_add(v128_t a, v128_t b) {
+    v128_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = (int32_t)((uint32_t)a.lanes[i] + (uint32_t)b.lanes[i]);
+    return r;
+}
+static inline v128_t wasm_i32x4_sub(v128_t a, v128_t b) {
+    v128_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = (int32_t)((uint32_t)a.lanes[i] - (uint32_t)b.lanes[i]);
+    return r;
+}
+static inline v128_t wasm_i32x4_gt(v128_t a, v128_t b) {
+    v128_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = a.lanes[i] > b.lanes[i] ? -1 : 0;
+    return r;
+}
+static inline v128_t wasm_v128_and(v128_t a, v128_t b) {
+    v128_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = a.lanes[i] & b.lanes[i];
+    return r;
+}
+// a & ~b
+static inline v128_t wasm_v128_andnot(v128_t a, v128_t b) {
+    v128_t r;
+    NUI_MODEL_LANES(i) r.lanes[i] = a.lanes[i] & ~b.lanes[i];
+    return r;
+}
+static inline v128_t wasm_i32x4_min(v128_t a, v128_t b) {
+    v128_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = a.lanes[i] < b.lanes[i] ? a.lanes[i] : b.lanes[i];
+    return r;
+}
+static inline v128_t wasm_i32x4_max(v128_t a, v128_t b) {
+    v128_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = a.lanes[i] > b.lanes[i] ? a.lanes[i] : b.lanes[i];
+    return r;
+}
+// Logical shift, the count taken modulo the lane width
+static inline v128_t wasm_u32x4_shr(v128_t a, uint32_t n) {
+    v128_t r;
+    NUI_MODEL_LANES(i)
+    r.lanes[i] = (int32_t)((uint32_t)a.lanes[i] >> (n & 31));
+    return r;
+}
+// The top bit of each lane, lane 0 in bit 0
+static inline uint32_t wasm_i32x4_bitmask(v128_t a) {
+    uint32_t r = 0;
+    NUI_MODEL_LANES(i) r |= ((uint32_t)a.lanes[i] >> 31) << i;
+    return r;
+}
+
+#undef NUI_MODEL_LANES
+
+#endif // NUI_MODEL_WASM_SIMD128_H
@@ -0,0 +1,295 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nui.h"
+
+// Drives random widget and window sequences through a context, including
+// unbalanced pushes and pops, widgets outside of windows, more windows than
+// the container list holds and extreme coordinates, sizes and scales. Built
+// with ASan and UBSan by `make stress`, so that any overflow or out of bounds
+// access fails the run. Every limit hit must show up in the counters, and
+// the command stream must stay well formed.
+
+#define TITLE_COUNT (NUI_CONTAINER_LIST_SIZE + 16)
+
+static unsigned int rng_state;
+
+// xorshift32, so that a failing seed reproduces on every platform
+static unsigned int random_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int random_int(int min, int max) {
+    return min + (int)(random_next() % ((unsigned int)(max - min) + 1u));
+}
+
+// Mostly screen sized values, sometimes extreme ones
+static int random_coord(void) {
+    switch (random_int(0, 15)) {
+    case 0:
+        return INT_MAX;
+    case 1:
+        return INT_MIN;
+    case 2:
+        return random_int(-20000000, 20000000);
+    case 3:
+        return random_int(-1000, 0);
+    default:
+        return random_int(0, 2000);
+    }
+}
+
+static int random_size(void) {
+    return random_int(0, 3) == 0 ? random_coord() : random_int(0, 400);
+}
+
+static NUI_AABB random_area(void) {
+    return (NUI_AABB){random_coord(), random_coord(), random_size(),
+                      random_size()};
+}
+
+// Text of random length, with words sometimes longer than
+// NUI_MAX_WORD_LENGTH and runs of spaces and newlines
+static void random_text(char *text, int capacity) {
+    int length = random_int(0, 4) == 0 ? random_int(0, capacity - 1)
+                                       : random_int(0, 64);
+    for (int i = 0; i < length; i++) {
+        int r = random_int(0, 15);
+        text[i] = r == 0 ? '\n' : r < 4 ? ' ' : (char)('a' + r);
+    }
+    text[length] = '\0';
+}
+
+// Measures most text in proportion to its length, and some of it with
+// extreme or negative metrics as a broken font might
+static void measure_text(NUI_UserFont font, const char *text, int *out_width,
+                         int *out_height) {
+    (void)font;
+    size_t length = strlen(text);
+    if (length > 0 && text[0] == 'o') {
+        *out_width = INT_MAX;
+        *out_height = INT_MAX;
+    } else if (length > 0 && text[0] == 'n') {
+        *out_width = -(int)length;
+        *out_height = -16;
+    } else {
+        *out_width = 8 * (int)length;
+        *out_height = 16;
+    }
+}
+
+static NUI_Size random_column(void) {
+    NUI_Size size = {(NUI_SizeKind)random_int(0, 2), random_coord()};
+    if (random_int(0, 1))
+        size.value = random_int(-10, 100);
+    return size;
+}
+
+static void random_widgets(NUI_Context *ctx, char *text, int capacity,
+                           int *scroll) {
+    int count = random_int(0, 64);
+    for (int i = 0; i < count; i++) {
+        switch (random_int(0, 11)) {
+        case 0:
+            nui_layout_push(ctx, random_area(),
+                            (NUI_LayoutMode)random_int(0, 1));
+            break;
+        case 1:
+            nui_layout_pop(ctx);
+            break;
+        case 2:
+            nui_scissors_push(ctx, random_area());
+            break;
+        case 3:
+            nui_scissors_pop(ctx);
+            break;
+        case 4: {
+            NUI_Size columns[NUI_LAYOUT_MAX_COLUMNS + 4];
+            int column_count = random_int(-2, NUI_LAYOUT_MAX_COLUMNS + 4);
+            for (int c = 0; c < column_count; c++)
+                columns[c] = random_column();
+            nui_layout_row(ctx, column_count, columns, random_size());
+        } break;
+        case 5:
+            random_text(text, capacity);
+            nui_text(ctx, text);
+            break;
+        case 6:
+            random_text(text, capacity);
+            nui_text_area(ctx, text, random_size(),
+                          random_int(0, 1) ? scroll : NULL);
+            break;
+        case 7:
+            nui_image(ctx, (NUI_UserTexture)(size_t)random_int(1, 4),
+                      random_size(), random_size(), (NUI_UVRect){0, 0, 1, 1});
+            break;
+        default: {
+            static const char *labels[] = {"OK", "Cancel", "okay", "no", ""};
+            nui_button(ctx, labels[random_int(0, 4)]);
+        } break;
+        }
+    }
+}
+
+static int failures = 0;
+
+#define EXPECT(cond)                                                           \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "%s:%d: invariant failed: %s\n", __FILE__,         \
+                    __LINE__, #cond);                                          \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+static void check_limits(const NUI_LimitCounters *limits) {
+    EXPECT(limits->dropped_commands >= 0);
+    EXPECT(limits->layout_overflows >= 0);
+    EXPECT(limits->layout_underflows >= 0);
+    EXPECT(limits->scissors_overflows >= 0);
+    EXPECT(limits->scissors_underflows >= 0);
+    EXPECT(limits->container_overflows >= 0);
+    EXPECT(limits->column_overflows >= 0);
+    EXPECT(limits->orphan_widgets >= 0);
+    EXPECT(limits->allocation_failures == 0);
+}
+
+// Drains the frame's commands, checking that each is well formed
+static void check_commands(NUI_Context *ctx) {
+    int count = 0;
+    nui_command_stream_hash(ctx, &count);
+    EXPECT(count <= NUI_MAX_COMMANDS);
+
+    int drained = 0;
+    NUI_Command cmd;
+    while (nui_next_command(ctx, &cmd)) {
+        drained++;
+        switch (cmd.type) {
+        case NUI_CMD_RECT:
+            EXPECT(cmd.rect.rect.w > 0 && cmd.rect.rect.h > 0);
+            break;
+        case NUI_CMD_IMAGE:
+            EXPECT(cmd.image.rect.w > 0 && cmd.image.rect.h > 0);
+            EXPECT(cmd.image.texture != NULL);
+            if (random_int(0, 1)) {
+                NUI_CommandImage batch[8];
+                drained += nui_next_image_batch(ctx, cmd.image.texture, batch,
+                                                8);
+            }
+            break;
+        case NUI_CMD_TEXT:
+            EXPECT(cmd.text.length >= 0);
+            EXPECT(cmd.text.length == 0 || cmd.text.text != NULL);
+            break;
+        case NUI_CMD_SCISSORS:
+            EXPECT(cmd.scissors.area.w >= 0 && cmd.scissors.area.h >= 0);
+            break;
+        case NUI_CMD_CACHED_CONTAINER:
+            EXPECT(cmd.cached.command_count >= 0);
+            break;
+        default:
+            EXPECT(!"unknown command type");
+            break;
+        }
+    }
+    EXPECT(drained == count);
+}
+
+static void run(unsigned int seed, int frames) {
+    static char text[4096];
+    static char titles[TITLE_COUNT][16];
+    for (int i = 0; i < TITLE_COUNT; i++)
+        snprintf(titles[i], sizeof(titles[i]), "Window %d", i);
+
+    rng_state = seed ? seed : 1;
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+    int scroll = 0;
+
+    for (int frame = 0; frame < frames; frame++) {
+        if (random_int(0, 63) == 0) {
+            float scales[] = {0.0001f, 0.5f, 1.0f, 1.5f, 3.0f, 1000.0f};
+            nui_set_scale(&ctx, scales[random_int(0, 5)]);
+        }
+        if (random_int(0, 1))
+            nui_input_mouse_move(&ctx, random_coord(), random_coord());
+        if (random_int(0, 3) == 0)
+            nui_input_mouse_button(&ctx, random_int(0, 1));
+
+        nui_frame_begin(&ctx);
+        int windows = random_int(0, TITLE_COUNT);
+        for (int w = 0; w < windows; w++) {
+            // Widgets outside of any window
+            if (random_int(0, 7) == 0)
+                random_widgets(&ctx, text, sizeof(text), &scroll);
+
+            const char *title = titles[random_int(0, TITLE_COUNT - 1)];
+            int flags = random_int(0, 1) ? NUI_WINDOW_CACHED : NUI_WINDOW_NONE;
+            if (nui_window_begin(&ctx, title, random_area(), flags)) {
+                random_widgets(&ctx, text, sizeof(text), &scroll);
+                // Sometimes leave the window open
+                if (random_int(0, 15) != 0)
+                    nui_window_end(&ctx);
+            }
+            if (random_int(0, 31) == 0)
+                nui_container_invalidate(&ctx, title);
+        }
+        nui_frame_end(&ctx);
+
+        check_limits(&ctx.limits);
+        check_commands(&ctx);
+    }
+
+    nui_destroy(&ctx);
+}
+
+// Drags a window to x = 20000000, which used to overflow the fixed-point
+// window area
+static void drag_far(void) {
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+
+    for (int frame = 0; frame < 4; frame++) {
+        if (frame == 1)
+            nui_input_mouse_move(&ctx, 20, 20);
+        if (frame == 2)
+            nui_input_mouse_button(&ctx, true);
+        if (frame == 3)
+            nui_input_mouse_move(&ctx, 20000000, 20000000);
+
+        nui_frame_begin(&ctx);
+        if (nui_window_begin(&ctx, "Far", (NUI_AABB){10, 10, 200, 100},
+                             NUI_WINDOW_NONE)) {
+            nui_button(&ctx, "OK");
+            nui_window_end(&ctx);
+        }
+        nui_frame_end(&ctx);
+        check_commands(&ctx);
+    }
+
+    nui_destroy(&ctx);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int seed = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 0) : 1;
+    int runs = argc > 2 ? atoi(argv[2]) : 64;
+    int frames = argc > 3 ? atoi(argv[3]) : 200;
+
+    drag_far();
+    for (int i = 0; i < runs; i++) {
+        run(seed + i, frames);
+        if (failures > 0) {
+            fprintf(stderr, "stress: failed with seed %u\n", seed + i);
+            return 1;
+        }
+    }
+
+    printf("stress: %d runs of %d frames from seed %u ok\n", runs, frames,
+           seed);
+    return 0;
+}
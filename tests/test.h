@@ -0,0 +1,53 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for the headless tests, each test is its own program and
+// returns the number of failed checks from main
+static int test_failures = 0;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_INT(actual, expected)                                            \
+    do {                                                                       \
+        int actual_ = (actual);                                                \
+        int expected_ = (expected);                                            \
+        if (actual_ != expected_) {                                            \
+            fprintf(stderr, "%s:%d: %s is %d, expected %d\n", __FILE__,        \
+                    __LINE__, #actual, actual_, expected_);                    \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_AABB(actual, ex, ey, ew, eh)                                     \
+    do {                                                                       \
+        NUI_AABB actual_ = (actual);                                           \
+        if (actual_.x != (ex) || actual_.y != (ey) || actual_.w != (ew) ||     \
+            actual_.h != (eh)) {                                               \
+            fprintf(stderr,                                                    \
+                    "%s:%d: %s is {%d, %d, %d, %d}, expected {%d, %d, %d, "    \
+                    "%d}\n",                                                   \
+                    __FILE__, __LINE__, #actual, actual_.x, actual_.y,         \
+                    actual_.w, actual_.h, (ex), (ey), (ew), (eh));             \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+static inline int test_report(const char *name) {
+    if (test_failures > 0) {
+        fprintf(stderr, "%s: %d checks failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // TEST_H
@@ -0,0 +1,147 @@
+#include <string.h>
+
+#include "nui.h"
+#include "test.h"
+
+#define MAX_RECTS (67)
+
+typedef struct {
+    int x[MAX_RECTS], y[MAX_RECTS], w[MAX_RECTS], h[MAX_RECTS];
+} RectArrays;
+
+static NUI_AABBArray arrays(RectArrays *r) {
+    return (NUI_AABBArray){r->x, r->y, r->w, r->h};
+}
+
+// xorshift32, so that failures reproduce on every platform
+static unsigned int rng_state = 0x12345678u;
+
+static int random_int(int min, int max) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return min + (int)(rng_state % (unsigned int)(max - min + 1));
+}
+
+static void random_rects(RectArrays *r, int count) {
+    for (int i = 0; i < count; i++) {
+        // Mostly small overlapping rects, sometimes empty, inverted or
+        // unbounded ones
+        r->x[i] = random_int(-64, 64);
+        r->y[i] = random_int(-64, 64);
+        r->w[i] = random_int(-8, 64);
+        r->h[i] = random_int(-8, 64);
+        if (random_int(0, 15) == 0) {
+            r->w[i] = 0x10000000;
+            r->h[i] = 0x10000000;
+        }
+    }
+}
+
+static void test_clip_matches_scalar(void) {
+    for (int iteration = 0; iteration < 2000; iteration++) {
+        int count = random_int(0, MAX_RECTS);
+        RectArrays rects, scissors, simd, scalar, in_place;
+        int simd_visible[MAX_RECTS], scalar_visible[MAX_RECTS];
+        int in_place_visible[MAX_RECTS];
+        random_rects(&rects, count);
+        random_rects(&scissors, count);
+        in_place = rects;
+
+        nui_aabb_clip_batch(arrays(&rects), arrays(&scissors), arrays(&simd),
+                            simd_visible, count);
+        nui_aabb_clip_batch_scalar(arrays(&rects), arrays(&scissors),
+                                   arrays(&scalar), scalar_visible, count);
+        nui_aabb_clip_batch(arrays(&in_place), arrays(&scissors),
+                            arrays(&in_place), in_place_visible, count);
+
+        size_t size = count * sizeof(int);
+        CHECK(memcmp(simd.x, scalar.x, size) == 0);
+        CHECK(memcmp(simd.y, scalar.y, size) == 0);
+        CHECK(memcmp(simd.w, scalar.w, size) == 0);
+        CHECK(memcmp(simd.h, scalar.h, size) == 0);
+        CHECK(memcmp(simd_visible, scalar_visible, size) == 0);
+
+        CHECK(memcmp(in_place.x, scalar.x, size) == 0);
+        CHECK(memcmp(in_place.w, scalar.w, size) == 0);
+        CHECK(memcmp(in_place_visible, scalar_visible, size) == 0);
+    }
+}
+
+static void test_clip_edges(void) {
+    // Overlapping, touching, inside and negative sized rects, repeated to
+    // cover both the SIMD groups and the scalar tail
+    NUI_AABB cases[][3] = {
+        // rect, scissors, expected
+        {{0, 0, 10, 10}, {5, 5, 10, 10}, {5, 5, 5, 5}},
+        {{0, 0, 10, 10}, {10, 0, 10, 10}, {0, 0, 0, 0}},
+        {{2, 2, 4, 4}, {0, 0, 10, 10}, {2, 2, 4, 4}},
+        {{0, 0, -5, 10}, {-10, -10, 20, 20}, {0, 0, 0, 0}},
+        {{-20, 3, 30, 1}, {0, 0, 0x10000000, 0x10000000}, {0, 3, 10, 1}},
+    };
+    int case_count = sizeof(cases) / sizeof(cases[0]);
+
+    RectArrays rects, scissors, out;
+    int visible[MAX_RECTS];
+    int count = case_count * 3;
+    for (int i = 0; i < count; i++) {
+        NUI_AABB *c = cases[i % case_count];
+        rects.x[i] = c[0].x, rects.y[i] = c[0].y;
+        rects.w[i] = c[0].w, rects.h[i] = c[0].h;
+        scissors.x[i] = c[1].x, scissors.y[i] = c[1].y;
+        scissors.w[i] = c[1].w, scissors.h[i] = c[1].h;
+    }
+
+    nui_aabb_clip_batch(arrays(&rects), arrays(&scissors), arrays(&out),
+                        visible, count);
+    for (int i = 0; i < count; i++) {
+        NUI_AABB e = cases[i % case_count][2];
+        CHECK_AABB(((NUI_AABB){out.x[i], out.y[i], out.w[i], out.h[i]}), e.x,
+                   e.y, e.w, e.h);
+        CHECK_INT(visible[i], e.w > 0);
+    }
+}
+
+static void test_hit_test_matches_scalar(void) {
+    for (int iteration = 0; iteration < 2000; iteration++) {
+        int count = random_int(0, MAX_RECTS);
+        RectArrays rects;
+        random_rects(&rects, count);
+
+        for (int point = 0; point < 16; point++) {
+            int x = random_int(-80, 140);
+            int y = random_int(-80, 140);
+            CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), count, x, y),
+                      nui_aabb_hit_test_batch_scalar(arrays(&rects), count, x,
+                                                     y));
+        }
+    }
+}
+
+static void test_hit_test_top_most(void) {
+    // Nine stacked rects, the highest index containing the point wins
+    RectArrays rects;
+    for (int i = 0; i < 9; i++) {
+        rects.x[i] = i * 10;
+        rects.y[i] = 0;
+        rects.w[i] = 25;
+        rects.h[i] = 10;
+    }
+
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 9, 0, 0), 0);
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 9, 24, 5), 2);
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 9, 25, 5), 2);
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 9, 30, 5), 3);
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 9, 104, 9), 8);
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 9, 105, 5), -1);
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 9, 10, 10), -1);
+    CHECK_INT(nui_aabb_hit_test_batch(arrays(&rects), 0, 10, 5), -1);
+}
+
+int main(void) {
+    test_clip_matches_scalar();
+    test_clip_edges();
+    test_hit_test_matches_scalar();
+    test_hit_test_top_most();
+    return test_report("test_aabb");
+}
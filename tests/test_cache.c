@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "nui.h"
+#include "test.h"
+
+static void measure_text(NUI_UserFont font, const char *text, int *out_width,
+                         int *out_height) {
+    (void)font;
+    *out_width = 8 * (int)strlen(text);
+    *out_height = 16;
+}
+
+// Draws a cached window and returns its header command
+static NUI_CommandCachedContainer cached_frame(NUI_Context *ctx) {
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Cached", (NUI_AABB){20, 20, 200, 150},
+                         NUI_WINDOW_CACHED)) {
+        nui_button(ctx, "First");
+        nui_button(ctx, "Second");
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+
+    NUI_Command cmd;
+    if (!nui_next_command(ctx, &cmd) || cmd.type != NUI_CMD_CACHED_CONTAINER) {
+        CHECK(!"cached window emitted no header");
+        return (NUI_CommandCachedContainer){0};
+    }
+    return cmd.cached;
+}
+
+static void test_unchanged_content_is_not_redrawn(void) {
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+
+    NUI_CommandCachedContainer first = cached_frame(&ctx);
+    CHECK(first.dirty);
+    CHECK(first.command_count > 0);
+
+    // The redraw is in container-local coordinates, starting with the title
+    // bar at the origin
+    NUI_Command cmd;
+    CHECK(nui_next_command(&ctx, &cmd));
+    CHECK_INT(cmd.type, NUI_CMD_RECT);
+    CHECK_AABB(cmd.rect.rect, 0, 0, 200, 32);
+
+    NUI_CommandCachedContainer second = cached_frame(&ctx);
+    CHECK(!second.dirty);
+    CHECK_INT(second.command_count, 0);
+    CHECK(!nui_next_command(&ctx, &cmd));
+
+    nui_container_invalidate(&ctx, "Cached");
+    NUI_CommandCachedContainer third = cached_frame(&ctx);
+    CHECK(third.dirty);
+    CHECK_INT(third.command_count, first.command_count);
+
+    // Backends evicting a target only know the container by its id
+    nui_container_invalidate_id(&ctx, third.id);
+    CHECK(cached_frame(&ctx).dirty);
+
+    nui_destroy(&ctx);
+}
+
+static void test_drag_only_moves_the_target(void) {
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+    cached_frame(&ctx);
+
+    // Grab the title bar and drag the window past the top-left corner of
+    // the screen, where the screen would clip it
+    nui_input_mouse_move(&ctx, 30, 30);
+    cached_frame(&ctx);
+    nui_input_mouse_button(&ctx, true);
+    cached_frame(&ctx);
+
+    for (int step = 1; step <= 10; step++) {
+        nui_input_mouse_move(&ctx, 30 - step * 10, 30 - step * 10);
+        NUI_CommandCachedContainer cached = cached_frame(&ctx);
+        CHECK(!cached.dirty);
+        CHECK_AABB(cached.area, 20 - step * 10, 20 - step * 10, 200, 182);
+    }
+
+    nui_input_mouse_button(&ctx, false);
+    CHECK(!cached_frame(&ctx).dirty);
+
+    nui_destroy(&ctx);
+}
+
+int main(void) {
+    test_unchanged_content_is_not_redrawn();
+    test_drag_only_moves_the_target();
+    return test_report("test_cache");
+}
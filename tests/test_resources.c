@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "nui.h"
+#include "test.h"
+
+static int measure_calls = 0;
+
+// Measures 8 pixels per character at the font's scale, which the test sets
+// along with the context's as an application resizing its font would
+static int font_scale = 1;
+
+// Resources measured through again from inside the callback, which deadlocks
+// if the callback is called with their lock held
+static NUI_Resources *reentered = NULL;
+
+static void measure_text(NUI_UserFont font, const char *text, int *out_width,
+                         int *out_height) {
+    (void)font;
+    measure_calls++;
+    if (reentered && strcmp(text, "nested") != 0) {
+        int width, height;
+        nui_resources_measure_text(reentered, "nested", &width, &height);
+    }
+    *out_width = 8 * font_scale * (int)strlen(text);
+    *out_height = 16 * font_scale;
+}
+
+static void test_measure_is_cached(void) {
+    NUI_Resources *resources = nui_resources_create(measure_text, NULL);
+    int width, height;
+
+    measure_calls = 0;
+    nui_resources_measure_text(resources, "Save", &width, &height);
+    nui_resources_measure_text(resources, "Save", &width, &height);
+    CHECK_INT(measure_calls, 1);
+    CHECK_INT(width, 32);
+    CHECK_INT(height, 16);
+
+    nui_resources_destroy(resources);
+}
+
+static void test_measure_without_lock(void) {
+    NUI_Resources *resources = nui_resources_create(measure_text, NULL);
+    int width, height;
+
+    reentered = resources;
+    measure_calls = 0;
+    nui_resources_measure_text(resources, "Load", &width, &height);
+    reentered = NULL;
+    CHECK_INT(measure_calls, 2);
+    CHECK_INT(width, 32);
+
+    // Both texts got cached
+    nui_resources_measure_text(resources, "nested", &width, &height);
+    nui_resources_measure_text(resources, "Load", &width, &height);
+    CHECK_INT(measure_calls, 2);
+
+    nui_resources_destroy(resources);
+}
+
+static void test_shared_scale(void) {
+    NUI_Resources *resources = nui_resources_create(measure_text, NULL);
+    NUI_Context a, b;
+    nui_init_shared(&a, resources);
+    nui_init_shared(&b, resources);
+    int width, height;
+
+    font_scale = 1;
+    nui_resources_measure_text(resources, "Save", &width, &height);
+    CHECK_INT(width, 32);
+
+    // Scaling one context drops the text measured at the old scale and
+    // carries the other context along at its next frame
+    font_scale = 2;
+    nui_set_scale(&a, 2.0f);
+    nui_resources_measure_text(resources, "Save", &width, &height);
+    CHECK_INT(width, 64);
+
+    nui_frame_begin(&b);
+    if (nui_window_begin(&b, "Window", (NUI_AABB){10, 10, 100, 100},
+                         NUI_WINDOW_NONE)) {
+        nui_button(&b, "OK");
+        nui_window_end(&b);
+    }
+    nui_frame_end(&b);
+
+    NUI_Command cmd;
+    CHECK(nui_next_command(&b, &cmd));
+    CHECK_INT(cmd.type, NUI_CMD_RECT);
+    CHECK_AABB(cmd.rect.rect, 20, 20, 200, 64);
+
+    font_scale = 1;
+    nui_destroy(&b);
+    nui_destroy(&a);
+    nui_resources_destroy(resources);
+}
+
+static void test_wrapped_words_stay_out_of_resources(void) {
+    // More distinct words than the resources' cache holds
+    static char text[4096 * 6];
+    int length = 0;
+    for (int i = 0; i < 4096; i++)
+        length += snprintf(&text[length], sizeof(text) - length, "w%d ", i);
+
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+    for (int frame = 0; frame < 3; frame++) {
+        measure_calls = 0;
+        nui_frame_begin(&ctx);
+        if (nui_window_begin(&ctx, "Window", (NUI_AABB){10, 10, 300, 200},
+                             NUI_WINDOW_NONE)) {
+            nui_text(&ctx, text);
+            nui_button(&ctx, "Save");
+            nui_window_end(&ctx);
+        }
+        nui_frame_end(&ctx);
+    }
+
+    // Both the wrapped text and the label are measured once
+    CHECK_INT(measure_calls, 0);
+    nui_destroy(&ctx);
+}
+
+static void test_many_texts_are_not_rewrapped(void) {
+    // More texts than the context starts with layouts for, with more
+    // distinct words between them than its word cache holds, so that
+    // rewrapping any text would measure words again
+    enum { TEXT_COUNT = NUI_TEXT_LAYOUT_CACHE_SIZE * 2 };
+    static char texts[TEXT_COUNT][256 * 8];
+    for (int t = 0; t < TEXT_COUNT; t++) {
+        int length = 0;
+        for (int i = 0; i < 256; i++) {
+            length += snprintf(&texts[t][length], sizeof(texts[t]) - length,
+                               "t%dw%d ", t, i);
+        }
+    }
+
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+    for (int frame = 0; frame < 3; frame++) {
+        measure_calls = 0;
+        nui_frame_begin(&ctx);
+        if (nui_window_begin(&ctx, "Window", (NUI_AABB){10, 10, 300, 200},
+                             NUI_WINDOW_NONE)) {
+            for (int t = 0; t < TEXT_COUNT; t++)
+                nui_text(&ctx, texts[t]);
+            nui_window_end(&ctx);
+        }
+        nui_frame_end(&ctx);
+        CHECK_INT(ctx.limits.allocation_failures, 0);
+    }
+
+    CHECK_INT(measure_calls, 0);
+    nui_destroy(&ctx);
+}
+
+static void test_missing_resources_draw_nothing(void) {
+    // As nui_init leaves a context whose resources failed to allocate
+    NUI_Context ctx;
+    nui_init_shared(&ctx, NULL);
+    nui_set_scale(&ctx, 2.0f);
+    measure_calls = 0;
+
+    for (int frame = 0; frame < 2; frame++) {
+        nui_frame_begin(&ctx);
+        CHECK(!nui_window_begin(&ctx, "Window", (NUI_AABB){10, 10, 100, 100},
+                                NUI_WINDOW_NONE));
+        CHECK(!nui_button(&ctx, "OK"));
+        nui_text(&ctx, "Not measured");
+        nui_frame_end(&ctx);
+
+        NUI_Command cmd;
+        CHECK(!nui_next_command(&ctx, &cmd));
+        CHECK_INT(ctx.limits.allocation_failures, 1);
+    }
+    CHECK_INT(measure_calls, 0);
+    nui_destroy(&ctx);
+}
+
+int main(void) {
+    test_measure_is_cached();
+    test_measure_without_lock();
+    test_shared_scale();
+    test_wrapped_words_stay_out_of_resources();
+    test_many_texts_are_not_rewrapped();
+    test_missing_resources_draw_nothing();
+    return test_report("test_resources");
+}
@@ -0,0 +1,222 @@
+#include <string.h>
+
+#include "nui.h"
+#include "test.h"
+
+#define MAX_DRAWN (64)
+
+// Rects, label origins and scissors of a frame, in the order they were drawn
+typedef struct {
+    NUI_AABB rects[MAX_DRAWN];
+    int rect_count;
+    NUI_AABB labels[MAX_DRAWN];
+    int label_count;
+    NUI_AABB scissors[MAX_DRAWN];
+    int scissors_count;
+} Drawn;
+
+// Device pixel metrics that do not depend on the scale, as a font loaded at
+// the device size would be measured the same at any scale in this test
+static void measure_text(NUI_UserFont font, const char *text, int *out_width,
+                         int *out_height) {
+    (void)font;
+    *out_width = 8 * (int)strlen(text);
+    *out_height = 16;
+}
+
+static void collect(NUI_Context *ctx, Drawn *drawn) {
+    memset(drawn, 0, sizeof(*drawn));
+    NUI_Command cmd;
+    while (nui_next_command(ctx, &cmd)) {
+        switch (cmd.type) {
+        case NUI_CMD_RECT:
+            drawn->rects[drawn->rect_count++] = cmd.rect.rect;
+            break;
+        case NUI_CMD_TEXT:
+            drawn->labels[drawn->label_count++] =
+                (NUI_AABB){cmd.text.x, cmd.text.y, 0, 0};
+            break;
+        case NUI_CMD_SCISSORS:
+            drawn->scissors[drawn->scissors_count++] = cmd.scissors.area;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Draws a frame with a window holding two buttons
+static void two_buttons_frame(NUI_Context *ctx, NUI_AABB area, Drawn *drawn) {
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Scaled", area, NUI_WINDOW_NONE)) {
+        nui_button(ctx, "OK");
+        nui_button(ctx, "OK2");
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+
+    collect(ctx, drawn);
+}
+
+// Draws a window with two buttons at the given scale
+static void two_buttons(float scale, NUI_AABB area, Drawn *drawn) {
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+    nui_set_scale(&ctx, scale);
+    two_buttons_frame(&ctx, area, drawn);
+    nui_destroy(&ctx);
+}
+
+static void check_same_rects(const Drawn *actual, const Drawn *expected) {
+    CHECK_INT(actual->rect_count, expected->rect_count);
+    for (int i = 0; i < actual->rect_count && i < expected->rect_count; i++) {
+        CHECK_AABB(actual->rects[i], expected->rects[i].x,
+                   expected->rects[i].y, expected->rects[i].w,
+                   expected->rects[i].h);
+    }
+}
+
+static void test_scale_1x(void) {
+    Drawn d;
+    two_buttons(1.0f, (NUI_AABB){10, 20, 300, 130}, &d);
+
+    CHECK_INT(d.rect_count, 6);
+    // Title bar and body
+    CHECK_AABB(d.rects[0], 10, 20, 300, 32);
+    CHECK_AABB(d.rects[1], 10, 52, 300, 130);
+    // Border and inner rect of each button, one pixel apart
+    CHECK_AABB(d.rects[2], 20, 62, 40, 32);
+    CHECK_AABB(d.rects[3], 21, 63, 38, 30);
+    CHECK_AABB(d.rects[4], 20, 104, 48, 32);
+    CHECK_AABB(d.rects[5], 21, 105, 46, 30);
+    // Centered labels
+    CHECK_AABB(d.labels[1], 32, 70, 0, 0);
+    CHECK_AABB(d.labels[2], 32, 112, 0, 0);
+}
+
+static void test_scale_2x(void) {
+    Drawn d;
+    two_buttons(2.0f, (NUI_AABB){10, 20, 300, 130}, &d);
+
+    CHECK_INT(d.rect_count, 6);
+    CHECK_AABB(d.rects[0], 20, 40, 600, 64);
+    CHECK_AABB(d.rects[1], 20, 104, 600, 260);
+    CHECK_AABB(d.rects[2], 40, 124, 64, 48);
+    CHECK_AABB(d.rects[3], 42, 126, 60, 44);
+    CHECK_AABB(d.rects[4], 40, 192, 72, 48);
+    CHECK_AABB(d.rects[5], 42, 194, 68, 44);
+    CHECK_AABB(d.labels[1], 64, 140, 0, 0);
+    CHECK_AABB(d.labels[2], 64, 208, 0, 0);
+}
+
+static void test_scale_1_5x(void) {
+    // Odd logical coordinates land on half device pixels, which round up
+    Drawn d;
+    two_buttons(1.5f, (NUI_AABB){11, 21, 301, 131}, &d);
+
+    CHECK_INT(d.rect_count, 6);
+    CHECK_AABB(d.rects[0], 17, 32, 451, 48);
+    CHECK_AABB(d.rects[1], 17, 80, 451, 196);
+    // The 1.5 pixel border rounds to 2 pixels on every side, rather than
+    // leaving 2 pixels on one side and 1 on the other
+    CHECK_AABB(d.rects[2], 32, 95, 52, 40);
+    CHECK_AABB(d.rects[3], 34, 97, 48, 36);
+    CHECK_AABB(d.rects[4], 32, 150, 60, 40);
+    CHECK_AABB(d.rects[5], 34, 152, 56, 36);
+    CHECK_AABB(d.labels[1], 50, 107, 0, 0);
+    CHECK_AABB(d.labels[2], 50, 162, 0, 0);
+}
+
+static void test_row_1_5x(void) {
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+    nui_set_scale(&ctx, 1.5f);
+
+    nui_frame_begin(&ctx);
+    if (nui_window_begin(&ctx, "Row", (NUI_AABB){11, 21, 301, 131},
+                         NUI_WINDOW_NONE)) {
+        NUI_Size columns[] = {NUI_PX(20), NUI_PERCENT(50), NUI_FILL(1)};
+        nui_layout_row(&ctx, 3, columns, 0);
+        nui_button(&ctx, "A");
+        nui_button(&ctx, "B");
+        nui_button(&ctx, "C");
+        nui_window_end(&ctx);
+    }
+    nui_frame_end(&ctx);
+
+    Drawn d;
+    collect(&ctx, &d);
+    nui_destroy(&ctx);
+
+    // The content is 421 pixels wide at x = 32, leaving 391 after the two
+    // 15 pixel margins: 30 pixels, 50% = 195.5 and the remaining 165.5.
+    // Snapping each edge keeps the columns flush with the content's right
+    // edge and the margins exactly 15 pixels wide.
+    CHECK_INT(d.rect_count, 8);
+    CHECK_AABB(d.rects[2], 32, 95, 30, 40);
+    CHECK_AABB(d.rects[4], 77, 95, 196, 40);
+    CHECK_AABB(d.rects[6], 288, 95, 165, 40);
+}
+
+static void test_scale_change(void) {
+    // A window created at one scale looks the same at the next as one
+    // created there
+    NUI_AABB areas[] = {{10, 20, 300, 130}, {11, 21, 301, 131}};
+    float scales[] = {2.0f, 1.5f};
+    for (int i = 0; i < 2; i++) {
+        NUI_Context ctx;
+        nui_init(&ctx, measure_text, NULL);
+        Drawn before, after, fresh;
+        two_buttons_frame(&ctx, areas[i], &before);
+
+        nui_set_scale(&ctx, scales[i]);
+        two_buttons_frame(&ctx, areas[i], &after);
+        two_buttons(scales[i], areas[i], &fresh);
+        check_same_rects(&after, &fresh);
+
+        // And back again
+        nui_set_scale(&ctx, 1.0f);
+        two_buttons_frame(&ctx, areas[i], &after);
+        check_same_rects(&after, &before);
+        nui_destroy(&ctx);
+    }
+}
+
+static void test_logical_units(void) {
+    // Scissors and layout areas are in logical pixels like every other area
+    NUI_Context ctx;
+    nui_init(&ctx, measure_text, NULL);
+    nui_set_scale(&ctx, 2.0f);
+
+    nui_frame_begin(&ctx);
+    if (nui_window_begin(&ctx, "Units", (NUI_AABB){10, 20, 300, 130},
+                         NUI_WINDOW_NONE)) {
+        nui_scissors_push(&ctx, (NUI_AABB){0, 0, 100, 150});
+        nui_layout_push(&ctx, (NUI_AABB){30, 70, 50, 50},
+                        NUI_LAYOUT_VERTICAL);
+        nui_button(&ctx, "OK");
+        nui_layout_pop(&ctx);
+        nui_scissors_pop(&ctx);
+        nui_window_end(&ctx);
+    }
+    nui_frame_end(&ctx);
+
+    Drawn d;
+    collect(&ctx, &d);
+    nui_destroy(&ctx);
+
+    // Scissors of 200x300 device pixels narrowed by the window's content,
+    // replacing the content scissors as nothing was drawn in between
+    CHECK_AABB(d.scissors[2], 40, 124, 160, 176);
+    CHECK_AABB(d.rects[2], 60, 140, 64, 48);
+}
+
+int main(void) {
+    test_scale_1x();
+    test_scale_2x();
+    test_scale_1_5x();
+    test_row_1_5x();
+    test_scale_change();
+    test_logical_units();
+    return test_report("test_scale");
+}
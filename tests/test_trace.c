@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "nui.h"
+#include "nui_trace.h"
+#include "test.h"
+
+// Absolute path passed in by the Makefile, so that the test runs from any
+// directory
+#ifndef TRACE_PATH
+#define TRACE_PATH "test_trace.trace"
+#endif
+
+static void measure_text(NUI_UserFont font, const char *text, int *out_width,
+                         int *out_height) {
+    (void)font;
+    *out_width = 8 * (int)strlen(text);
+    *out_height = 16;
+}
+
+// A window with a button and an image of the given texture
+static void frame(NUI_Context *ctx, NUI_UserTexture texture) {
+    nui_frame_begin(ctx);
+    if (nui_window_begin(ctx, "Trace", (NUI_AABB){10, 10, 200, 150},
+                         NUI_WINDOW_NONE)) {
+        nui_button(ctx, "Click");
+        nui_image(ctx, texture, 16, 16, (NUI_UVRect){0, 0, 1, 1});
+        nui_window_end(ctx);
+    }
+    nui_frame_end(ctx);
+}
+
+static void record(int frames) {
+    int texture;
+    NUI_TraceRecorder recorder;
+    CHECK(nui_trace_record_begin(&recorder, TRACE_PATH, measure_text, NULL));
+
+    NUI_Context ctx;
+    nui_init(&ctx, nui_trace_record_measure_text, &recorder);
+    for (int i = 0; i < frames; i++) {
+        nui_trace_record_mouse_move(&recorder, &ctx, 20 + i, 50);
+        nui_trace_record_mouse_button(&recorder, &ctx, i % 2);
+        frame(&ctx, &texture);
+        nui_trace_record_frame(&recorder, &ctx);
+    }
+    nui_destroy(&ctx);
+    nui_trace_record_end(&recorder);
+}
+
+// Replays the trace, returning its final status and counting its frames
+static NUI_TraceStatus replay(int *out_frames, int *out_mismatches) {
+    // A different texture than the one recorded, as in a separate run
+    int texture;
+    NUI_TracePlayer player;
+    CHECK(nui_trace_play_begin(&player, TRACE_PATH));
+
+    NUI_Context ctx;
+    nui_init(&ctx, nui_trace_play_measure_text, &player);
+    NUI_TraceFrame expected;
+    NUI_TraceStatus status;
+    *out_frames = 0;
+    *out_mismatches = 0;
+    while ((status = nui_trace_play_frame(&player, &ctx, &expected)) ==
+           NUI_TRACE_FRAME) {
+        frame(&ctx, &texture);
+        int count;
+        NUI_Id hash = nui_command_stream_hash(&ctx, &count);
+        if (count != expected.command_count || hash != expected.command_hash)
+            (*out_mismatches)++;
+        (*out_frames)++;
+    }
+    nui_destroy(&ctx);
+    nui_trace_play_end(&player);
+    return status;
+}
+
+static void append(const char *text) {
+    FILE *file = fopen(TRACE_PATH, "a");
+    CHECK(file != NULL);
+    if (file) {
+        fputs(text, file);
+        fclose(file);
+    }
+}
+
+// Rewrites the trace without its last line, the E record
+static void truncate_end(void) {
+    char buffer[4096];
+    FILE *file = fopen(TRACE_PATH, "r");
+    size_t size = file ? fread(buffer, 1, sizeof(buffer), file) : 0;
+    if (file)
+        fclose(file);
+    CHECK(size > 0 && size < sizeof(buffer));
+    if (size == 0 || size >= sizeof(buffer))
+        return;
+
+    size_t end = size - 1;
+    while (end > 0 && buffer[end - 1] != '\n')
+        end--;
+    file = fopen(TRACE_PATH, "w");
+    if (file) {
+        fwrite(buffer, 1, end, file);
+        fclose(file);
+    }
+}
+
+static void test_replay_matches(void) {
+    int frames, mismatches;
+    record(5);
+    CHECK_INT(replay(&frames, &mismatches), NUI_TRACE_END);
+    CHECK_INT(frames, 5);
+    CHECK_INT(mismatches, 0);
+}
+
+static void test_truncated_trace_fails(void) {
+    int frames, mismatches;
+    record(5);
+    truncate_end();
+    CHECK_INT(replay(&frames, &mismatches), NUI_TRACE_ERROR);
+    CHECK_INT(frames, 5);
+}
+
+static void test_unknown_record_fails(void) {
+    int frames, mismatches;
+    record(3);
+    truncate_end();
+    append("X 1 2\nE 3\n");
+    CHECK_INT(replay(&frames, &mismatches), NUI_TRACE_ERROR);
+    CHECK_INT(frames, 3);
+}
+
+static void test_malformed_record_fails(void) {
+    int frames, mismatches;
+    record(3);
+    truncate_end();
+    append("M 1 oops\nE 3\n");
+    CHECK_INT(replay(&frames, &mismatches), NUI_TRACE_ERROR);
+}
+
+int main(void) {
+    test_replay_matches();
+    test_truncated_trace_fails();
+    test_unknown_record_fails();
+    test_malformed_record_fails();
+    remove(TRACE_PATH);
+    return test_report("test_trace");
+}